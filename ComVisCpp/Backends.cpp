@@ -0,0 +1,79 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+BackendSelection backends;
+
+// Every selectable implementation, grouped by stage; the first one of a stage is its default
+static const BackendEntry registry[] = {
+	{ "detection", "opencv", DETECTOR_OPENCV, "cv::findChessboardCorners on dilated adaptive thresholds" },
+	{ "detection", "saddle", DETECTOR_SADDLE, "findChessboardSaddles: saddle-point filter and grid assembly" },
+	{ "refinement", "batched", REFINE_BATCHED, "refineCorners with four corners per vector lane" },
+	{ "refinement", "cornersubpix", REFINE_CORNERSUBPIX, "cv::cornerSubPix" },
+	{ "calibration", "opencv", SOLVER_OPENCV, "cv::calibrateCamera" },
+	{ "calibration", "sparse", SOLVER_SPARSE, "calibrateSparse: Levenberg-Marquardt linear in the number of views" },
+	{ "projection", "batch", PROJECTION_BATCH, "projectPointsBatch on structure-of-arrays points" },
+	{ "projection", "opencv", PROJECTION_OPENCV, "cv::projectPoints" },
+	{ "rendering", "manual", RENDERING_MANUAL, "drawAxesManually" },
+	{ "rendering", "opencv", RENDERING_OPENCV, "drawAxes with cv::projectPoints and cv::line" },
+};
+
+Span<BackendEntry> backendRegistry() {
+	return Span<BackendEntry>(registry, sizeof(registry) / sizeof(registry[0]));
+}
+
+// Selects an implementation by its stage and name; returns false and changes nothing when there is no such entry
+bool selectBackend(const std::string& stage, const std::string& name) {
+	for (const BackendEntry& entry : backendRegistry()) {
+		if (stage != entry.stage || name != entry.name) continue;
+		if (stage == "detection") backends.detection = (ChessboardDetector) entry.id;
+		else if (stage == "refinement") backends.refinement = (RefinementBackend) entry.id;
+		else if (stage == "calibration") backends.calibration = (CalibrationSolver) entry.id;
+		else if (stage == "projection") backends.projection = (ProjectionBackend) entry.id;
+		else if (stage == "rendering") backends.rendering = (RenderingBackend) entry.id;
+		return true;
+	}
+	printf("Unknown %s backend %s\n", stage.c_str(), name.c_str());
+	return false;
+}
+
+// Applies a comma separated list of stage=name selections, e.g. "detection=saddle,calibration=sparse"
+// Returns false when any of them is not in the registry; the valid ones are applied regardless
+bool applyBackendConfig(const std::string& config) {
+	bool valid = true;
+	std::stringstream items(config);
+	std::string item;
+	while (std::getline(items, item, ',')) {
+		size_t separator = item.find('=');
+		if (separator == std::string::npos) {
+			printf("Backend selection %s is not stage=name\n", item.c_str());
+			valid = false;
+			continue;
+		}
+		valid = selectBackend(item.substr(0, separator), item.substr(separator + 1)) && valid;
+	}
+	return valid;
+}
+
+// Name of the implementation a stage currently runs, or nullptr for an unknown stage
+const char* selectedBackend(const std::string& stage) {
+	int id = -1;
+	if (stage == "detection") id = backends.detection;
+	else if (stage == "refinement") id = backends.refinement;
+	else if (stage == "calibration") id = backends.calibration;
+	else if (stage == "projection") id = backends.projection;
+	else if (stage == "rendering") id = backends.rendering;
+	for (const BackendEntry& entry : backendRegistry()) {
+		if (stage == entry.stage && id == entry.id) return entry.name;
+	}
+	return nullptr;
+}
+
+// Lists every implementation, marking the selected one of each stage
+void printBackends() {
+	for (const BackendEntry& entry : backendRegistry()) {
+		bool selected = strcmp(selectedBackend(entry.stage), entry.name) == 0;
+		printf("%c %-12s %-13s %s\n", selected ? '*' : ' ', entry.stage, entry.name, entry.description);
+	}
+}
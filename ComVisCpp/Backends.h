@@ -0,0 +1,50 @@
+#pragma once
+
+// Implementations of refineCorners
+enum RefinementBackend
+{
+	REFINE_BATCHED,     // four corners per vector lane (see Refinement.cpp)
+	REFINE_CORNERSUBPIX // cv::cornerSubPix with the same window and criteria
+};
+
+// Implementations of computeReprojectionErrors
+enum ProjectionBackend
+{
+	PROJECTION_BATCH, // projectPointsBatch on the board as structure of arrays
+	PROJECTION_OPENCV // cv::projectPoints view by view
+};
+
+// How the axes are drawn on the calibration views
+enum RenderingBackend
+{
+	RENDERING_MANUAL, // drawAxesManually
+	RENDERING_OPENCV  // drawAxes
+};
+
+// The implementation every pipeline stage runs
+// detection is the detector main puts into the DetectionOptions it builds, the others are read where they apply
+struct BackendSelection
+{
+	ChessboardDetector detection = DETECTOR_OPENCV;
+	RefinementBackend refinement = REFINE_BATCHED;
+	CalibrationSolver calibration = SOLVER_OPENCV;
+	ProjectionBackend projection = PROJECTION_BATCH;
+	RenderingBackend rendering = RENDERING_MANUAL;
+};
+
+// One named implementation of a stage; id is its value in BackendSelection
+struct BackendEntry
+{
+	const char* stage;
+	const char* name;
+	int id;
+	const char* description;
+};
+
+extern BackendSelection backends;
+
+Span<BackendEntry> backendRegistry();
+bool selectBackend(const std::string& stage, const std::string& name);
+bool applyBackendConfig(const std::string& config);
+const char* selectedBackend(const std::string& stage);
+void printBackends();
\ No newline at end of file
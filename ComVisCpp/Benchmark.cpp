@@ -0,0 +1,703 @@
+#include "pch.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+// Stage-level benchmark of the calibration pipeline on the chessboard data set
+// Every stage collects one latency sample per timed call, divided by the number of items that call processed,
+// and the whole run is reported as JSON with throughput, p50/p99 latency and the peak resident set size
+//
+//   ComVisBench [--data <dir>] [--count <images>] [--repeat <runs>] [--json <file>] [--mode <all | backends>] [--isa <name>]
+//
+// The backends mode only runs every registered implementation of every stage on the same inputs (see Backends.h)
+// --isa pins the kernel variants every stage runs (see Dispatch.h); the report names the one in use
+
+typedef std::chrono::steady_clock Clock;
+
+struct StageStats
+{
+	std::string name;
+	size_t items = 0;
+	double totalSeconds = 0.0;
+	std::vector<double> latencies; // seconds per item, one entry per timed call
+	double meanErrorPx = -1.0;     // mean distance to reference corners, for the stages that measure accuracy
+	long long found = -1;          // searches that found the board, for the stages that count them
+};
+
+// Times fn, which processes items items, and adds the sample to stats
+template <typename F>
+static void timeStage(StageStats& stats, size_t items, F&& fn) {
+	Clock::time_point start = Clock::now();
+	fn();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	stats.items += items;
+	stats.totalSeconds += seconds;
+	stats.latencies.push_back(items ? seconds / items : seconds);
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+	if (values.empty()) return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t rank = (size_t) std::ceil(fraction * values.size());
+	return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// Peak resident set size of the process in bytes
+static uint64_t peakResidentBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return (uint64_t) counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (uint64_t) usage.ru_maxrss;
+#else
+	return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static void writeJson(FILE* out, const std::deque<StageStats>& stages, size_t imageCount, int repeat) {
+	fprintf(out, "{\n  \"images\": %zu,\n  \"repeat\": %d,\n  \"isa\": \"%s\",\n  \"peak_rss_bytes\": %llu,\n  \"stages\": [\n", imageCount, repeat, isaName(kernels.isa), (unsigned long long) peakResidentBytes());
+	for (size_t i = 0; i < stages.size(); i++) {
+		const StageStats& s = stages[i];
+		double throughput = s.totalSeconds > 0 ? s.items / s.totalSeconds : 0.0;
+		char extras[96] = "";
+		if (s.meanErrorPx >= 0.0) sprintf(extras, ", \"mean_error_px\": %.6g", s.meanErrorPx);
+		if (s.found >= 0) sprintf(extras + strlen(extras), ", \"found\": %lld", s.found);
+		fprintf(out, "    { \"name\": \"%s\", \"items\": %zu, \"total_s\": %.6f, \"throughput_per_s\": %.3f, \"p50_ms\": %.6f, \"p99_ms\": %.6f%s }%s\n",
+			s.name.c_str(), s.items, s.totalSeconds, throughput, percentile(s.latencies, 0.50) * 1e3, percentile(s.latencies, 0.99) * 1e3,
+			extras, i + 1 < stages.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+// Image the given view of a calibration from corner sets lies in; calibrateFromCorners numbers the views by corner
+// set, and foundImages maps every corner set to the image it was found in
+static const Mat& viewImage(const std::vector<Mat>& images, const std::vector<size_t>& foundImages, const CalibrationResult& calibration, size_t view) {
+	return images[foundImages[calibration.viewIndices[view]]];
+}
+
+// Writes the report to jsonPath only, as the stages print their diagnostics to stdout; returns the exit code of the benchmark
+static int writeReport(const std::string& jsonPath, const std::deque<StageStats>& stages, size_t imageCount, int repeat) {
+	FILE* out = fopen(jsonPath.c_str(), "w");
+	if (!out) {
+		printf("Could not write %s\n", jsonPath.c_str());
+		return 1;
+	}
+	writeJson(out, stages, imageCount, repeat);
+	fclose(out);
+	printf("Wrote %s\n", jsonPath.c_str());
+	return 0;
+}
+
+// Sum of the distances between corners and reference index for index, so a detector that orders the board differently
+// shows up as a large error instead of being matched up; adds the number of corners to compared
+static double cornerDistance(const std::vector<Point2f>& corners, const std::vector<Point2f>& reference, size_t& compared) {
+	double sum = 0.0;
+	size_t count = std::min(corners.size(), reference.size());
+	for (size_t i = 0; i < count; i++) sum += norm(corners[i] - reference[i]);
+	compared += count;
+	return sum;
+}
+
+// Runs every registered backend of every stage on the same inputs, one stage entry named backend_<stage>_<name> each
+// The first backend of a stage is its reference: the corners it finds and the calibration it solves feed the later
+// stages, and mean_error_px of the others is how far they land from it (the RMS error for calibration)
+static void benchmarkBackends(std::deque<StageStats>& stages, const std::vector<Mat>& images, const std::vector<Mat>& grayImages, Size boardDim, float cellSize, int repeat) {
+	BackendSelection selected = backends;
+	auto stageBackends = [&](const char* stageName) {
+		std::vector<const BackendEntry*> entries;
+		for (const BackendEntry& entry : backendRegistry()) {
+			if (strcmp(entry.stage, stageName) == 0) entries.push_back(&entry);
+		}
+		return entries;
+	};
+	auto runBackend = [&](const BackendEntry& entry) -> StageStats& {
+		selectBackend(entry.stage, entry.name);
+		stages.push_back(StageStats());
+		stages.back().name = std::string("backend_") + entry.stage + "_" + entry.name;
+		return stages.back();
+	};
+
+	std::vector<std::vector<Point2f>> foundPoints, referenceCorners(grayImages.size());
+	std::vector<size_t> foundImages;
+	std::vector<const BackendEntry*> entries = stageBackends("detection");
+	for (size_t b = 0; b < entries.size(); b++) {
+		StageStats& s = runBackend(*entries[b]);
+		DetectionOptions options;
+		options.detector = backends.detection;
+		double errorSum = 0.0;
+		size_t compared = 0;
+		for (size_t i = 0; i < grayImages.size(); i++) {
+			std::vector<Point2f> corners;
+			bool found = false;
+			timeStage(s, 1, [&] { found = detectChessboard(grayImages[i], 1.0, boardDim, corners, options); });
+			if (!found) continue;
+			if (b > 0) {
+				if (!referenceCorners[i].empty()) errorSum += cornerDistance(corners, referenceCorners[i], compared);
+				continue;
+			}
+			referenceCorners[i] = corners;
+			foundPoints.push_back(corners);
+			foundImages.push_back(i);
+		}
+		if (b > 0 && compared) s.meanErrorPx = errorSum / compared;
+	}
+	if (foundPoints.empty()) {
+		printf("The board was not found in any image\n");
+		backends = selected;
+		return;
+	}
+
+	std::vector<std::vector<Point2f>> referenceRefined;
+	entries = stageBackends("refinement");
+	for (size_t b = 0; b < entries.size(); b++) {
+		StageStats& s = runBackend(*entries[b]);
+		std::vector<std::vector<Point2f>> refined;
+		for (int r = 0; r < repeat; r++) {
+			refined = foundPoints;
+			timeStage(s, refined.size(), [&] { refineCornersBatch(grayImages, refined, &foundImages); });
+		}
+		if (b == 0) {
+			referenceRefined = refined;
+			continue;
+		}
+		double errorSum = 0.0;
+		size_t compared = 0;
+		for (size_t v = 0; v < refined.size(); v++) errorSum += cornerDistance(refined[v], referenceRefined[v], compared);
+		if (compared) s.meanErrorPx = errorSum / compared;
+	}
+
+	CalibrationResult calibration;
+	entries = stageBackends("calibration");
+	for (size_t b = 0; b < entries.size(); b++) {
+		StageStats& s = runBackend(*entries[b]);
+		CalibrationResult result;
+		for (int r = 0; r < repeat; r++) {
+			timeStage(s, foundPoints.size(), [&] { result = calibrateFromCorners(foundPoints, images[0].size(), boardDim, cellSize); });
+		}
+		s.meanErrorPx = result.projectionError;
+		if (b == 0) calibration = result;
+	}
+
+	std::vector<Point3f> board;
+	createKnownBoardPosition(boardDim, cellSize, board);
+	std::vector<double> referenceErrors;
+	entries = stageBackends("projection");
+	for (size_t b = 0; b < entries.size(); b++) {
+		StageStats& s = runBackend(*entries[b]);
+		std::vector<double> errors;
+		for (int r = 0; r < repeat; r++) {
+			timeStage(s, calibration.extrinsics.size(), [&] { computeReprojectionErrors(calibration.intrinsics, calibration.extrinsics, foundPoints, board, errors); });
+		}
+		if (b == 0) {
+			referenceErrors = errors;
+			continue;
+		}
+		double difference = 0.0;
+		for (size_t v = 0; v < errors.size(); v++) difference += std::abs(errors[v] - referenceErrors[v]);
+		if (!errors.empty()) s.meanErrorPx = difference / errors.size();
+	}
+
+	NullSink discard;
+	entries = stageBackends("rendering");
+	for (size_t b = 0; b < entries.size(); b++) {
+		StageStats& s = runBackend(*entries[b]);
+		for (size_t v = 0; v < calibration.extrinsics.size(); v++) {
+			Mat canvas = viewImage(images, foundImages, calibration, v).clone();
+			const Extrinsics& view = calibration.extrinsics[v];
+			timeStage(s, 1, [&] {
+				if (backends.rendering == RENDERING_MANUAL) drawAxesManually(canvas, calibration.intrinsics, view, boardDim, cellSize, discard);
+				else drawAxes(canvas, calibration.intrinsics, view, discard);
+			});
+		}
+	}
+	backends = selected;
+}
+
+int main(int argc, char** argv)
+{
+	const float cellSize = 0.022833f;
+	const Size boardDim = Size(6, 9);
+
+	std::string dataDirectory = "data", jsonPath = "benchmark.json", mode = "all";
+	int imageCount = 63, repeat = 3;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string flag = argv[i];
+		if (flag == "--data") dataDirectory = argv[i + 1];
+		else if (flag == "--count") imageCount = atoi(argv[i + 1]);
+		else if (flag == "--repeat") repeat = std::max(1, atoi(argv[i + 1]));
+		else if (flag == "--json") jsonPath = argv[i + 1];
+		else if (flag == "--mode") mode = argv[i + 1];
+		else if (flag == "--isa") selectIsa(std::string(argv[i + 1]));
+		else printf("Unknown option %s\n", flag.c_str());
+	}
+
+	std::vector<std::string> imagePaths;
+	for (int i = 1; i <= imageCount; i++) imagePaths.push_back(dataDirectory + "/chessboard" + to_string(i) + ".jpg");
+
+	std::deque<StageStats> stages; // Stable references while stages are added
+	bool failed = false; // An equivalence check disagreed; the report is still written, the exit code says so
+	auto stage = [&](const char* name) -> StageStats& {
+		stages.push_back(StageStats());
+		stages.back().name = name;
+		return stages.back();
+	};
+
+	// Decode
+	std::vector<Mat> images(imagePaths.size()), grayImages(imagePaths.size());
+	{
+		StageStats& color = stage("decode_color");
+		for (size_t i = 0; i < imagePaths.size(); i++) timeStage(color, 1, [&] { images[i] = imread(imagePaths[i]); });
+	}
+	{
+		StageStats& gray = stage("decode_grayscale");
+		for (size_t i = 0; i < imagePaths.size(); i++) timeStage(gray, 1, [&] { grayImages[i] = imread(imagePaths[i], IMREAD_GRAYSCALE); });
+	}
+	if (mode == "backends") {
+		benchmarkBackends(stages, images, grayImages, boardDim, cellSize, repeat);
+		return writeReport(jsonPath, stages, imagePaths.size(), repeat);
+	}
+
+	// Corner detection
+	std::vector<std::vector<Point2f>> foundPoints;
+	std::vector<size_t> foundImages;
+	{
+		StageStats& serial = stage("get_chessboard_corners");
+		for (size_t i = 0; i < images.size(); i++) {
+			std::vector<std::vector<Point2f>> found;
+			timeStage(serial, 1, [&] { getChessboardCorners(Span<Mat>(&images[i], 1), boardDim, found); });
+			for (std::vector<Point2f>& corners : found) {
+				foundPoints.push_back(std::move(corners));
+				foundImages.push_back(i);
+			}
+		}
+	}
+	{
+		// All views refined as one batch, against cv::cornerSubPix view by view with the same window and criteria
+		StageStats& batch = stage("refine_corners_batch");
+		StageStats& opencv = stage("refine_corners_cornersubpix");
+		double errorSum = 0.0;
+		size_t compared = 0;
+		for (int r = 0; r < repeat; r++) {
+			std::vector<std::vector<Point2f>> refined = foundPoints;
+			timeStage(batch, refined.size(), [&] { refineCornersBatch(grayImages, refined, &foundImages); });
+			for (size_t v = 0; v < foundPoints.size(); v++) {
+				std::vector<Point2f> reference = foundPoints[v];
+				int halfWindow = windowForSpacing(reference);
+				timeStage(opencv, 1, [&] { cornerSubPix(grayImages[foundImages[v]], reference, Size(halfWindow, halfWindow), Size(-1, -1), TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 20, 0.01)); });
+				errorSum += cornerDistance(refined[v], reference, compared);
+			}
+		}
+		if (compared) batch.meanErrorPx = errorSum / compared;
+	}
+	{
+		StageStats& parallel = stage("get_chessboard_corners_parallel");
+		for (int r = 0; r < repeat; r++) {
+			std::vector<std::vector<Point2f>> found;
+			timeStage(parallel, images.size(), [&] { getChessboardCornersParallel(images, boardDim, found); });
+		}
+	}
+	{
+		DetectionOptions coarseToFine;
+		coarseToFine.pyramidLevels = 1;
+		coarseToFine.refine = true;
+		StageStats& pyramid = stage("detect_coarse_to_fine");
+		for (size_t i = 0; i < grayImages.size(); i++) {
+			std::vector<Point2f> corners;
+			timeStage(pyramid, 1, [&] { detectChessboard(grayImages[i], 1.0, boardDim, corners, coarseToFine); });
+		}
+	}
+	{
+		// The saddle detector against OpenCV with sub-pixel refinement, which serves as the reference for accuracy
+		// Both order the board the same way (see canonicalOrder), so corners are compared index for index
+		DetectionOptions reference;
+		reference.refine = true;
+		DetectionOptions saddle;
+		saddle.detector = DETECTOR_SADDLE;
+		StageStats& saddleStage = stage("detect_saddle");
+		double errorSum = 0.0;
+		size_t compared = 0;
+		for (size_t i = 0; i < grayImages.size(); i++) {
+			std::vector<Point2f> corners, referenceCorners;
+			bool found = false;
+			timeStage(saddleStage, 1, [&] { found = detectChessboard(grayImages[i], 1.0, boardDim, corners, saddle); });
+			if (!found || !detectChessboard(grayImages[i], 1.0, boardDim, referenceCorners, reference)) continue;
+			errorSum += cornerDistance(corners, referenceCorners, compared);
+		}
+		if (compared) saddleStage.meanErrorPx = errorSum / compared;
+	}
+	{
+		// A synthetic clip: the first image drifting and turning slowly, as a hand-held board does between frames
+		std::vector<Mat> clip(30);
+		Point2f center(grayImages[0].cols * 0.5f, grayImages[0].rows * 0.5f);
+		for (size_t f = 0; f < clip.size(); f++) {
+			Mat motion = getRotationMatrix2D(center, 0.2 * f, 1.0);
+			motion.at<double>(0, 2) += 1.5 * f;
+			motion.at<double>(1, 2) += 0.8 * f;
+			warpAffine(grayImages[0], clip[f], motion, grayImages[0].size());
+		}
+		StageStats& detectEvery = stage("video_detect_every_frame");
+		StageStats& track = stage("video_track_board");
+		for (int r = 0; r < repeat; r++) {
+			BoardTracker tracker(boardDim);
+			for (const Mat& frame : clip) {
+				std::vector<Point2f> corners;
+				timeStage(detectEvery, 1, [&] { detectChessboard(frame, 1.0, boardDim, corners, DetectionOptions()); });
+				timeStage(track, 1, [&] { tracker.update(frame, corners); });
+			}
+		}
+	}
+	if (foundPoints.empty()) {
+		printf("The board was not found in any image\n");
+		return 1;
+	}
+
+	// Calibration
+	CalibrationResult calibration;
+	{
+		StageStats& calibrate = stage("camera_calibration");
+		for (int r = 0; r < repeat; r++) {
+			timeStage(calibrate, foundPoints.size(), [&] { calibration = calibrateFromCorners(foundPoints, images[0].size(), boardDim, cellSize); });
+		}
+	}
+	{
+		// Same views through the sparse solver; mean_error_px is how far apart the two calibrations put the corners
+		StageStats& sparse = stage("camera_calibration_sparse");
+		CalibrationResult sparseCalibration;
+		for (int r = 0; r < repeat; r++) {
+			timeStage(sparse, foundPoints.size(), [&] { sparseCalibration = calibrateSparse(foundPoints, images[0].size(), boardDim, cellSize); });
+		}
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		double distance = 0.0;
+		for (size_t v = 0; v < foundPoints.size(); v++) {
+			std::vector<Point2f> a, b;
+			projectPoints(board, calibration.extrinsics[v].r, calibration.extrinsics[v].t, calibration.intrinsics.K, calibration.intrinsics.D, a);
+			projectPoints(board, sparseCalibration.extrinsics[v].r, sparseCalibration.extrinsics[v].t, sparseCalibration.intrinsics.K, sparseCalibration.intrinsics.D, b);
+			for (size_t i = 0; i < a.size(); i++) distance += norm(a[i] - b[i]);
+		}
+		sparse.meanErrorPx = distance / (foundPoints.size() * board.size());
+	}
+	{
+		// Building the maps against reading them back, then undistorting every image with one remap per frame
+		StageStats& build = stage("undistortion_maps_build");
+		StageStats& load = stage("undistortion_maps_load");
+		StageStats& undistort = stage("undistort_frame");
+		Size imageSize = images[0].size();
+		UndistortionMaps maps;
+		std::string mapPath = "benchmark_undistort.bin";
+		uint64_t key = undistortionKey(calibration.intrinsics, imageSize, 0.0);
+		for (int r = 0; r < repeat; r++) {
+			timeStage(build, 1, [&] { maps = buildUndistortionMaps(calibration.intrinsics, imageSize); });
+			saveUndistortionMaps(mapPath, key, maps);
+			timeStage(load, 1, [&] { loadUndistortionMaps(mapPath, key, maps); });
+		}
+		std::remove(mapPath.c_str());
+		Mat undistorted;
+		for (int r = 0; r < repeat; r++) {
+			for (const Mat& image : images) timeStage(undistort, 1, [&] { undistortFrame(image, undistorted, maps); });
+		}
+	}
+	{
+		// A virtual right camera 6 cm to the side and turned by 2 degrees sees the found boards through the same intrinsics
+		// mean_error_px is the vertical offset left between matching corners after rectification, which should be ~0
+		StageStats& stereoStage = stage("stereo_calibration");
+		StageStats& rectify = stage("rectify_stereo_pair");
+		Matx33d toRight = rotationVectorToMatx(Vec3d(0.0, 2.0 * CV_PI / 180.0, 0.0));
+		Vec3d baseline(-0.06, 0.0, 0.0);
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		std::vector<std::vector<Point2f>> rightPoints(foundPoints.size());
+		for (size_t v = 0; v < foundPoints.size(); v++) {
+			Matx33d R = toRight * rotationVectorToMatx(Vec3d(calibration.extrinsics[v].r));
+			Vec3d t = toRight * Vec3d(calibration.extrinsics[v].t) + baseline;
+			projectPoints(board, Vec3d(rotationMatxToVector(R)), t, calibration.intrinsics.K, calibration.intrinsics.D, rightPoints[v]);
+		}
+		StereoCalibrationResult stereo;
+		for (int r = 0; r < repeat; r++) {
+			timeStage(stereoStage, foundPoints.size(), [&] { stereo = calibrateStereoFromCorners(foundPoints, rightPoints, images[0].size(), boardDim, cellSize); });
+		}
+		if (!stereo.left.K.empty()) {
+			double offset = 0.0;
+			size_t count = 0;
+			for (size_t v = 0; v < foundPoints.size(); v++) {
+				std::vector<Point2f> left, right;
+				undistortPoints(foundPoints[v], left, stereo.left.K, stereo.left.D, stereo.R1, stereo.P1);
+				undistortPoints(rightPoints[v], right, stereo.right.K, stereo.right.D, stereo.R2, stereo.P2);
+				for (size_t i = 0; i < left.size(); i++, count++) offset += std::abs(left[i].y - right[i].y);
+			}
+			stereoStage.meanErrorPx = offset / count;
+
+			StereoRectificationMaps maps = buildStereoRectificationMaps(stereo);
+			Mat rectifiedLeft, rectifiedRight;
+			for (int r = 0; r < repeat; r++) {
+				for (const Mat& image : images) timeStage(rectify, 1, [&] { rectifyStereoPair(image, image, rectifiedLeft, rectifiedRight, maps); });
+			}
+		}
+	}
+	{
+		// Eight virtual cameras around the real one, each missing a quarter of the boards
+		// mean_error_px is the RMS reprojection error of the joint solve, which should be ~0 on these exact corners
+		const size_t rigCameras = 8;
+		StageStats& rigStage = stage("rig_calibration");
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		std::vector<std::vector<std::vector<Point2f>>> rigCorners(rigCameras, std::vector<std::vector<Point2f>>(foundPoints.size()));
+		for (size_t c = 0; c < rigCameras; c++) {
+			Matx33d toCamera = rotationVectorToMatx(Vec3d(0.0, (c % 4) * CV_PI / 180.0, (c / 4) * CV_PI / 180.0));
+			Vec3d offset(-0.03 * (c % 4), -0.03 * (c / 4), 0.0);
+			for (size_t v = 0; v < foundPoints.size(); v++) {
+				if (c > 0 && (v + c) % 4 == 0) continue;
+				Matx33d R = toCamera * rotationVectorToMatx(Vec3d(calibration.extrinsics[v].r));
+				Vec3d t = toCamera * Vec3d(calibration.extrinsics[v].t) + offset;
+				projectPoints(board, Vec3d(rotationMatxToVector(R)), t, calibration.intrinsics.K, calibration.intrinsics.D, rigCorners[c][v]);
+			}
+		}
+		std::vector<Size> rigSizes(rigCameras, images[0].size());
+		RigCalibrationResult rig;
+		for (int r = 0; r < repeat; r++) {
+			timeStage(rigStage, rigCameras, [&] { rig = calibrateRigFromCorners(rigCorners, rigSizes, boardDim, cellSize); });
+		}
+		rigStage.meanErrorPx = rig.projectionError;
+	}
+	{
+		OutlierRejectionOptions rejection;
+		rejection.enabled = true;
+		StageStats& robust = stage("camera_calibration_reject_outliers");
+		for (int r = 0; r < repeat; r++) {
+			timeStage(robust, foundPoints.size(), [&] { calibrateRejectingOutliers(foundPoints, images[0].size(), boardDim, cellSize, rejection); });
+		}
+	}
+	{
+		// Each view searched again inside the region its own pose predicts, against the full-frame search above
+		// found should equal the number of views; fewer means the regions miss the boards
+		StageStats& region = stage("detect_in_predicted_region");
+		region.found = 0;
+		for (size_t i = 0; i < calibration.extrinsics.size(); i++) {
+			const Mat& image = viewImage(grayImages, foundImages, calibration, i);
+			std::vector<Point2f> corners;
+			bool found = false;
+			timeStage(region, 1, [&] {
+				Rect roi = predictBoardRegion(calibration.intrinsics, calibration.extrinsics[i], boardDim, cellSize, image.size());
+				found = detectChessboardInRegion(image, roi, boardDim, corners, DetectionOptions());
+			});
+			if (found) region.found++;
+		}
+		if (region.found < (long long) calibration.extrinsics.size()) printf("detect_in_predicted_region found %lld of %zu boards\n", region.found, calibration.extrinsics.size());
+	}
+
+	// Pose math, timed in blocks because a single call is below the clock resolution
+	const int block = 1000;
+	{
+		StageStats& matPath = stage("pose_math_mat");
+		for (int r = 0; r < repeat; r++) {
+			for (const Extrinsics& view : calibration.extrinsics) {
+				timeStage(matPath, block, [&] {
+					for (int i = 0; i < block; i++) {
+						Mat Rt = makeTransformationMatrix(rotationVectorToMatrix(view.r), view.t);
+						CV_Assert(Rt.cols == 4);
+					}
+				});
+			}
+		}
+		StageStats& matxPath = stage("pose_math_matx");
+		volatile double sink = 0.0;
+		for (int r = 0; r < repeat; r++) {
+			for (const Extrinsics& view : calibration.extrinsics) {
+				Vec3d rvec(view.r), tvec(view.t);
+				timeStage(matxPath, block, [&] {
+					for (int i = 0; i < block; i++) sink = sink + makeTransformationMatx(rotationVectorToMatx(rvec), tvec)(2, 3);
+				});
+			}
+		}
+
+		// The Mat path stays the reference: the fixed-size path has to agree with it and with cv::Rodrigues on every view
+		// mean_error_px of pose_math_matx is the largest element difference here, not a distance in pixels
+		double difference = 0.0;
+		for (const Extrinsics& view : calibration.extrinsics) {
+			Matx34d reference = makeTransformationMatrix(rotationVectorToMatrix(view.r), view.t);
+			Matx33d R = rotationVectorToMatx(Vec3d(view.r)), rodrigues;
+			Rodrigues(view.r, rodrigues);
+			difference = std::max(difference, norm(reference - makeTransformationMatx(R, Vec3d(view.t)), NORM_INF));
+			difference = std::max(difference, norm(rodrigues - R, NORM_INF));
+		}
+		matxPath.meanErrorPx = difference;
+		if (difference > 1e-12) {
+			printf("The fixed-size pose math differs from the Mat path or cv::Rodrigues by %g\n", difference);
+			failed = true;
+		}
+	}
+	{
+		// Every view drifting slowly through 30 frames: a cold solvePnP per frame against the estimator warm-started
+		// from the frame before; mean_error_px is the RMS reprojection error of the warm-started poses
+		StageStats& cold = stage("pose_solvepnp_cold");
+		StageStats& warm = stage("pose_warm_start");
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		const Intrinsics& intrinsics = calibration.intrinsics;
+		double squaredError = 0.0;
+		size_t pointCount = 0;
+		for (int r = 0; r < repeat; r++) {
+			for (const Extrinsics& view : calibration.extrinsics) {
+				BoardPoseEstimator estimator(boardDim, cellSize);
+				for (int f = 0; f < 30; f++) {
+					Vec3d rvec = Vec3d(view.r) + Vec3d(0.002, -0.001, 0.003) * f, tvec = Vec3d(view.t) + Vec3d(0.001, 0.0005, -0.001) * f;
+					std::vector<Point2f> corners, projected;
+					projectPoints(board, rvec, tvec, intrinsics.K, intrinsics.D, corners);
+					Mat coldR, coldT;
+					timeStage(cold, 1, [&] { solvePnP(board, corners, intrinsics.K, intrinsics.D, coldR, coldT); });
+					Extrinsics pose;
+					bool found = false;
+					timeStage(warm, 1, [&] { found = estimator.estimate(intrinsics, corners, pose); });
+					if (!found) continue;
+					projectPoints(board, pose.r, pose.t, intrinsics.K, intrinsics.D, projected);
+					for (size_t i = 0; i < corners.size(); i++) squaredError += (projected[i] - corners[i]).dot(projected[i] - corners[i]);
+					pointCount += corners.size();
+				}
+			}
+		}
+		if (pointCount) warm.meanErrorPx = sqrt(squaredError / pointCount);
+	}
+	{
+		// Pose of every view from its detected corners: iterative solvePnP against the closed-form planar solver with
+		// zero, one and two refinement steps; mean_error_px is the RMS reprojection error of each
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		const Intrinsics& intrinsics = calibration.intrinsics;
+		auto reprojectionError = [&](const Extrinsics& pose, const std::vector<Point2f>& corners) {
+			std::vector<Point2f> projected;
+			projectPoints(board, pose.r, pose.t, intrinsics.K, intrinsics.D, projected);
+			double squared = 0.0;
+			for (size_t i = 0; i < corners.size(); i++) squared += (projected[i] - corners[i]).dot(projected[i] - corners[i]);
+			return squared;
+		};
+		const char* names[4] = { "pose_solvepnp", "pose_planar", "pose_planar_lm1", "pose_planar_lm2" };
+		for (int solver = 0; solver < 4; solver++) {
+			StageStats& poseStage = stage(names[solver]);
+			double squared = 0.0;
+			size_t pointCount = 0;
+			for (int r = 0; r < repeat; r++) {
+				for (const std::vector<Point2f>& corners : foundPoints) {
+					Extrinsics pose;
+					timeStage(poseStage, 1, [&] {
+						if (solver == 0) solvePnP(board, corners, intrinsics.K, intrinsics.D, pose.r, pose.t);
+						else planarPose(intrinsics, board, corners, pose, solver - 1);
+					});
+					squared += reprojectionError(pose, corners);
+					pointCount += corners.size();
+				}
+			}
+			poseStage.meanErrorPx = sqrt(squared / pointCount);
+		}
+	}
+
+	// Board reprojection of every view
+	{
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		StageStats& opencv = stage("project_points_opencv");
+		for (int r = 0; r < repeat; r++) {
+			std::vector<Point2f> projected;
+			timeStage(opencv, calibration.extrinsics.size(), [&] {
+				for (const Extrinsics& view : calibration.extrinsics) projectPoints(board, view.r, view.t, calibration.intrinsics.K, calibration.intrinsics.D, projected);
+			});
+		}
+		StageStats& batch = stage("reprojection_errors_batch");
+		for (int r = 0; r < repeat; r++) {
+			std::vector<double> errors;
+			timeStage(batch, calibration.extrinsics.size(), [&] { computeReprojectionErrors(calibration.intrinsics, calibration.extrinsics, foundPoints, board, errors); });
+		}
+	}
+	{
+		// Every kernel variant this CPU runs, on the stages that spend their time in the kernels; the variant --isa
+		// picked is restored for the stages after these
+		CpuIsa selected = kernels.isa;
+		std::vector<Point3f> board;
+		createKnownBoardPosition(boardDim, cellSize, board);
+		DetectionOptions saddle;
+		saddle.detector = DETECTOR_SADDLE;
+
+		// Reference for the projection kernels: cv::projectPoints in double precision with all 8 coefficients, k4-k6
+		// included, which the calibration never solves for; mean_error_px of isa_*_project_points_batch is the largest
+		// per-point difference from it, not a reprojection error
+		Intrinsics rational;
+		rational.K = calibration.intrinsics.K;
+		rational.D = (Mat_<double>(1, 8) << -0.12, 0.08, 0.001, -0.0005, -0.02, 0.03, -0.01, 0.004);
+		ProjectionModel model = makeProjectionModel(rational);
+		PointsSoA points = makePointsSoA(board);
+		std::vector<Point3d> boardPoints(board.begin(), board.end());
+		std::vector<Matx33d> rotations;
+		std::vector<Vec3d> translations;
+		std::vector<Point2d> reference;
+		for (const Extrinsics& view : calibration.extrinsics) {
+			Matx33d R;
+			Rodrigues(view.r, R);
+			rotations.push_back(R);
+			translations.push_back(Vec3d(view.t));
+			std::vector<Point2d> projected;
+			projectPoints(boardPoints, view.r, view.t, rational.K, rational.D, projected);
+			reference.insert(reference.end(), projected.begin(), projected.end());
+		}
+
+		for (int isa = ISA_BASELINE; isa <= detectCpuIsa(); isa++) {
+			selectIsa((CpuIsa) isa);
+			std::string prefix = std::string("isa_") + isaName((CpuIsa) isa);
+			StageStats& batch = stage((prefix + "_project_points_batch").c_str());
+			std::vector<double> u(reference.size()), v(reference.size());
+			for (int r = 0; r < repeat; r++) {
+				timeStage(batch, rotations.size(), [&] { projectPointsBatch(model, rotations, translations, points, u.data(), v.data()); });
+			}
+			double difference = 0.0;
+			for (size_t i = 0; i < reference.size(); i++) difference = std::max(difference, std::max(std::abs(u[i] - reference[i].x), std::abs(v[i] - reference[i].y)));
+			batch.meanErrorPx = difference;
+			if (difference > 1e-9) {
+				printf("The %s projection kernel differs from cv::projectPoints by %g px\n", isaName((CpuIsa) isa), difference);
+				failed = true;
+			}
+			StageStats& projection = stage((prefix + "_reprojection_errors").c_str());
+			for (int r = 0; r < repeat; r++) {
+				std::vector<double> errors;
+				timeStage(projection, calibration.extrinsics.size(), [&] { computeReprojectionErrors(calibration.intrinsics, calibration.extrinsics, foundPoints, board, errors); });
+			}
+			StageStats& response = stage((prefix + "_detect_saddle").c_str());
+			for (size_t i = 0; i < grayImages.size(); i++) {
+				std::vector<Point2f> corners;
+				timeStage(response, 1, [&] { detectChessboard(grayImages[i], 1.0, boardDim, corners, saddle); });
+			}
+		}
+		selectIsa(selected);
+	}
+
+	// Overlays, rendered into a sink that discards them
+	{
+		NullSink discard;
+		StageStats& axes = stage("draw_axes");
+		StageStats& cube = stage("draw_cube");
+		StageStats& manual = stage("draw_axes_manually");
+		for (size_t i = 0; i < calibration.extrinsics.size(); i++) {
+			const Mat& image = viewImage(images, foundImages, calibration, i);
+			const Extrinsics& view = calibration.extrinsics[i];
+			timeStage(axes, 1, [&] { drawAxes(image, calibration.intrinsics, view, discard); });
+			timeStage(cube, 1, [&] { drawCube(image, cellSize, calibration.intrinsics, view, discard); });
+			Mat canvas = image.clone();
+			timeStage(manual, 1, [&] { drawAxesManually(canvas, calibration.intrinsics, view, boardDim, cellSize, discard); });
+		}
+	}
+
+	int code = writeReport(jsonPath, stages, imagePaths.size(), repeat);
+	return failed ? 1 : code;
+}
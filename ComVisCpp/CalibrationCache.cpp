@@ -0,0 +1,157 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+static const uint64_t fnvPrime = 1099511628211ull;
+
+// 64-bit FNV-1a over a block of bytes, continuing from hash
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*) data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= fnvPrime;
+	}
+	return hash;
+}
+
+// Continues hash over the contents of a file followed by its length, which keeps file boundaries apart
+// A missing file hashes like an empty one
+uint64_t hashFileContents(uint64_t hash, const std::string& path) {
+	std::vector<char> buffer(1 << 16);
+	std::ifstream file(path, std::ios::binary);
+	uint64_t fileSize = 0;
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		hash = fnv1a(hash, buffer.data(), (size_t) file.gcount());
+		fileSize += (uint64_t) file.gcount();
+	}
+	return fnv1a(hash, &fileSize, sizeof(fileSize));
+}
+
+// Continues hash over the board size and every detection option that changes the corners found
+uint64_t hashDetectionSettings(uint64_t hash, cv::Size boardSize, const DetectionOptions& options) {
+	int settings[9] = { boardSize.width, boardSize.height, options.grayscaleDecode, options.reducedDecode, options.pyramidLevels, options.refine, options.flags, options.detector, backends.refinement };
+	hash = fnv1a(hash, settings, sizeof(settings));
+	if (options.detector != DETECTOR_SADDLE) return hash;
+
+	const SaddleOptions& saddle = options.saddle;
+	int detector[2] = { saddle.smoothing, saddle.suppressionRadius };
+	float thresholds[2] = { saddle.threshold, saddle.minContrast };
+	uint64_t maxCandidates = saddle.maxCandidates;
+	hash = fnv1a(hash, detector, sizeof(detector));
+	hash = fnv1a(hash, thresholds, sizeof(thresholds));
+	return fnv1a(hash, &maxCandidates, sizeof(maxCandidates));
+}
+
+// Hashes everything a calibration result depends on: the contents of every image in order, the board geometry
+// and the detection options. File contents are hashed rather than names or timestamps, so a re-exported data set
+// with identical pixels still hits the cache and an edited image never does
+uint64_t hashCalibrationInputs(const std::vector<std::string>& imagePaths, cv::Size boardSize, float squareEdgeLength, const DetectionOptions& options) {
+	uint64_t hash = fnvOffsetBasis;
+	for (const std::string& path : imagePaths) hash = hashFileContents(hash, path);
+	hash = hashDetectionSettings(hash, boardSize, options);
+	hash = fnv1a(hash, &squareEdgeLength, sizeof(squareEdgeLength));
+	int solver[2] = { backends.calibration, outlierRejection.enabled };
+	hash = fnv1a(hash, solver, sizeof(solver));
+	if (!outlierRejection.enabled) return hash;
+
+	double thresholds[2] = { outlierRejection.madFactor, outlierRejection.minThreshold };
+	int limits[3] = { outlierRejection.maxRounds, (int) outlierRejection.minViews, outlierRejection.warmIterations };
+	hash = fnv1a(hash, thresholds, sizeof(thresholds));
+	return fnv1a(hash, limits, sizeof(limits));
+}
+
+// Location of the cache file for a given key
+std::string calibrationCachePath(const std::string& cacheDirectory, uint64_t key) {
+	char name[40];
+	sprintf(name, "calibration_%016llx.yml", (unsigned long long) key);
+	if (cacheDirectory.empty()) return name;
+	char last = cacheDirectory.back();
+	return cacheDirectory + (last == '/' || last == '\\' ? "" : "/") + name;
+}
+
+// Reads a calibration result written by saveCalibration
+// Returns false when the file is missing or was written for a different key
+bool loadCalibration(const std::string& path, uint64_t key, CalibrationResult& result) {
+	FileStorage fs;
+	try {
+		if (!fs.open(path, FileStorage::READ)) return false;
+	}
+	catch (const cv::Exception&) {
+		return false;
+	}
+
+	char keyText[20];
+	sprintf(keyText, "%016llx", (unsigned long long) key);
+	std::string storedKey;
+	fs["key"] >> storedKey;
+	if (storedKey != keyText) return false;
+
+	CalibrationResult loaded;
+	fs["K"] >> loaded.intrinsics.K;
+	fs["D"] >> loaded.intrinsics.D;
+	fs["projection_error"] >> loaded.projectionError;
+	if (loaded.intrinsics.K.empty() || loaded.intrinsics.D.empty()) return false;
+
+	FileNode views = fs["views"];
+	for (FileNodeIterator it = views.begin(); it != views.end(); ++it) {
+		Extrinsics extrinsics;
+		int index;
+		double error;
+		(*it)["index"] >> index;
+		(*it)["error"] >> error;
+		(*it)["r"] >> extrinsics.r;
+		(*it)["t"] >> extrinsics.t;
+		loaded.viewIndices.push_back((size_t) index);
+		loaded.viewErrors.push_back(error);
+		loaded.extrinsics.push_back(extrinsics);
+	}
+
+	result = loaded;
+	return true;
+}
+
+// Writes a calibration result together with the key of the inputs it was computed from
+void saveCalibration(const std::string& path, uint64_t key, const CalibrationResult& result) {
+	FileStorage fs(path, FileStorage::WRITE);
+	if (!fs.isOpened()) {
+		printf("Could not write calibration cache %s\n", path.c_str());
+		return;
+	}
+
+	char keyText[20];
+	sprintf(keyText, "%016llx", (unsigned long long) key);
+	fs << "key" << keyText;
+	fs << "K" << result.intrinsics.K;
+	fs << "D" << result.intrinsics.D;
+	fs << "projection_error" << result.projectionError;
+
+	fs << "views" << "[";
+	for (size_t i = 0; i < result.extrinsics.size(); i++) {
+		fs << "{";
+		fs << "index" << (int) result.viewIndices[i];
+		if (i < result.viewErrors.size()) fs << "error" << result.viewErrors[i];
+		fs << "r" << result.extrinsics[i].r;
+		fs << "t" << result.extrinsics[i].t;
+		fs << "}";
+	}
+	fs << "]";
+}
+
+// Same as cameraCalibrationStreaming, but reuses the result of an earlier run on identical inputs
+// The result is stored in cacheDirectory, which has to exist
+CalibrationResult cameraCalibrationCached(const std::string& cacheDirectory, const std::vector<std::string>& imagePaths, cv::Size boardSize, float squareEdgeLength, const DetectionOptions& options, size_t queueDepth, unsigned workerCount, CornerCache* cornerCache) {
+	uint64_t key = hashCalibrationInputs(imagePaths, boardSize, squareEdgeLength, options);
+	std::string path = calibrationCachePath(cacheDirectory, key);
+
+	CalibrationResult result;
+	if (loadCalibration(path, key, result)) {
+		printf("\nLoaded calibration from %s\n", path.c_str());
+		return result;
+	}
+
+	result = cameraCalibrationStreaming(imagePaths, boardSize, squareEdgeLength, options, queueDepth, workerCount, cornerCache);
+	saveCalibration(path, key, result);
+	return result;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size);
+uint64_t hashFileContents(uint64_t hash, const std::string& path);
+uint64_t hashDetectionSettings(uint64_t hash, cv::Size boardSize, const DetectionOptions& options);
+uint64_t hashCalibrationInputs(const std::vector<std::string>& imagePaths, cv::Size boardSize, float squareEdgeLength, const DetectionOptions& options);
+std::string calibrationCachePath(const std::string& cacheDirectory, uint64_t key);
+bool loadCalibration(const std::string& path, uint64_t key, CalibrationResult& result);
+void saveCalibration(const std::string& path, uint64_t key, const CalibrationResult& result);
+CalibrationResult cameraCalibrationCached(const std::string& cacheDirectory, const std::vector<std::string>& imagePaths, cv::Size boardSize, float squareEdgeLength, const DetectionOptions& options = DetectionOptions(), size_t queueDepth = 4, unsigned workerCount = 0, CornerCache* cornerCache = nullptr);
\ No newline at end of file
@@ -12,17 +12,68 @@ struct Extrinsics
 	cv::Mat t; // translation vector
 };
 
-bool explicitImplementation = true;
+// Result of a calibration run: the intrinsics shared by all views and the extrinsics of every view
+struct CalibrationResult
+{
+	Intrinsics intrinsics;
+	std::vector<Extrinsics> extrinsics;
+	std::vector<size_t> viewIndices; // input image each extrinsics entry belongs to
+	std::vector<double> viewErrors;  // RMS reprojection error of each view in pixels
+	double projectionError = 0.0;
+};
+
+// Read-only view of a contiguous range of elements, like std::span
+template <typename T>
+struct Span
+{
+	const T* first = nullptr;
+	size_t count = 0;
+
+	Span() {}
+	Span(const T* first, size_t count) : first(first), count(count) {}
+	Span(const std::vector<T>& v) : first(v.data()), count(v.size()) {}
+
+	const T* begin() const { return first; }
+	const T* end() const { return first + count; }
+	const T& operator[](size_t i) const { return first[i]; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+};
+
+class FrameSink;
+
+// Solvers calibrateFromCorners can run
+enum CalibrationSolver
+{
+	SOLVER_OPENCV, // cv::calibrateCamera
+	SOLVER_SPARSE  // calibrateSparse: Levenberg-Marquardt on the per-view block structure, linear in the number of views
+};
 
 void createKnownBoardPosition(cv::Size boardSize, float squareEdgeLength, std::vector<cv::Point3f>& corners);
-void getChessboardCorners(std::vector<cv::Mat> images, cv::Size boardSize, std::vector<std::vector<cv::Point2f>>& allFoundPoints, bool showResults = false);
-void cameraCalibration(std::vector<cv::Mat> calibrationImages, cv::Size boardSize, float squareEdgeLength, cv::Mat& cameraMatrix, cv::Mat& distortionCoefficients, std::vector<cv::Mat>& rvecs, std::vector<cv::Mat>& tvecs, bool showResults = false);
-void printMatrix(cv::Mat matrix, std::string header = "");
-void drawAxes(cv::Mat &inputImage, cv::Mat rvecs, cv::Mat tvecs, cv::Mat cameraMatrix, cv::Mat distMatrix);
-void drawCube(cv::Mat &inputImage, float dimension, cv::Mat rvecs, cv::Mat tvecs, cv::Mat cameraMatrix, cv::Mat distMatrix);
+void getChessboardCorners(Span<cv::Mat> images, cv::Size boardSize, std::vector<std::vector<cv::Point2f>>& allFoundPoints, FrameSink* resultSink = nullptr, std::vector<size_t>* foundIndices = nullptr);
+void getChessboardCornersParallel(Span<cv::Mat> images, cv::Size boardSize, std::vector<std::vector<cv::Point2f>>& allFoundPoints, unsigned workerCount = 0, std::vector<size_t>* foundIndices = nullptr);
+CalibrationResult cameraCalibration(Span<cv::Mat> calibrationImages, cv::Size boardSize, float squareEdgeLength, FrameSink* resultSink = nullptr, unsigned workerCount = 0);
+CalibrationResult calibrateFromCorners(const std::vector<std::vector<cv::Point2f>>& foundPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, const Intrinsics* initialGuess = nullptr, int maxIterations = 30, unsigned workerCount = 0);
+void printMatrix(const cv::Mat& matrix, const std::string& header = "");
+void drawAxes(const cv::Mat& inputImage, const Intrinsics& intrinsics, const Extrinsics& extrinsics, FrameSink& sink);
+void drawCube(const cv::Mat& inputImage, float dimension, const Intrinsics& intrinsics, const Extrinsics& extrinsics, FrameSink& sink);
+
+void drawAxesManually(cv::Mat& img, const Intrinsics& intrinsics, const Extrinsics& extrinsics, cv::Size boardDim, float cellSize, FrameSink& sink);
+cv::Mat rotationVectorToMatrix(const cv::Mat& rvec);
+cv::Mat makeTransformationMatrix(const cv::Mat& R, const cv::Mat& t);
+cv::Matx33d rotationVectorToMatx(const cv::Vec3d& rvec);
+cv::Vec3d rotationMatxToVector(const cv::Matx33d& R);
+cv::Matx34d makeTransformationMatx(const cv::Matx33d& R, const cv::Vec3d& t);
+
+// Projects the N homogeneous points in the columns of points through K * [R|t], without lens distortion
+// Everything is sized at compile time, so a projection does no heap allocation
+template <int N>
+void projectPinhole(const cv::Matx33d& K, const cv::Matx34d& Rt, const cv::Matx<double, 4, N>& points, cv::Point2d (&projected)[N])
+{
+	cv::Matx<double, 3, N> P = (K * Rt) * points;
+	for (int i = 0; i < N; i++) projected[i] = cv::Point2d(P(0, i) / P(2, i), P(1, i) / P(2, i));
+}
 
-void drawAxesManually(cv::Mat K, cv::Mat rvec, cv::Mat tvec, cv::Mat img, cv::Size boardDim, float cellSize);
-cv::Mat rotationVectorToMatrix(cv::Mat rvecs);
-cv::Mat makeTransformationMatrix(cv::Mat R, cv::Mat t);
+void printOpenCVMatrix(const cv::Mat& m);
 
-void printOpenCVMatrix(cv::Mat m);
\ No newline at end of file
+void parallelFor(size_t count, unsigned workerCount, const std::function<void(size_t)>& task);
\ No newline at end of file
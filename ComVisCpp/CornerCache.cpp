@@ -0,0 +1,189 @@
+#include "pch.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+static const char cornerCacheMagic[4] = { 'C', 'V', 'C', 'C' };
+static const uint32_t cornerCacheVersion = 1;
+
+static_assert(sizeof(Point2f) == 8, "Corner data is stored as pairs of 32-bit floats");
+
+// Key of an image in the corner cache: its file contents plus the settings it is searched with
+uint64_t cornerCacheKey(const std::string& imagePath, cv::Size boardSize, const DetectionOptions& options) {
+	return hashDetectionSettings(hashFileContents(fnvOffsetBasis, imagePath), boardSize, options);
+}
+
+CornerCache::CornerCache(const std::string& path) : path(path) {
+	map();
+}
+
+CornerCache::~CornerCache() {
+	unmap();
+}
+
+// Maps the cache file and checks that its index is consistent; a missing or damaged file leaves the cache empty
+bool CornerCache::map() {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG) sizeof(Header)) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!view) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	mapped = (const unsigned char*) view;
+	mappedSize = (size_t) size.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_size < (off_t) sizeof(Header)) {
+		close(fd);
+		return false;
+	}
+	void* view = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping stays valid without the descriptor
+	if (view == MAP_FAILED) return false;
+	mapped = (const unsigned char*) view;
+	mappedSize = (size_t) status.st_size;
+#endif
+
+	const Header* header = (const Header*) mapped;
+	size_t indexEnd = sizeof(Header) + header->recordCount * sizeof(Record);
+	if (memcmp(header->magic, cornerCacheMagic, 4) != 0 || header->version != cornerCacheVersion
+		|| header->recordCount > mappedSize / sizeof(Record) || indexEnd > mappedSize) {
+		printf("Ignoring invalid corner cache %s\n", path.c_str());
+		unmap();
+		return false;
+	}
+	records = (const Record*) (mapped + sizeof(Header));
+	recordCount = (size_t) header->recordCount;
+	return true;
+}
+
+void CornerCache::unmap() {
+	if (!mapped) return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapped);
+	CloseHandle((HANDLE) mappingHandle);
+	CloseHandle((HANDLE) fileHandle);
+	fileHandle = mappingHandle = nullptr;
+#else
+	munmap((void*) mapped, mappedSize);
+#endif
+	mapped = nullptr;
+	mappedSize = 0;
+	records = nullptr;
+	recordCount = 0;
+}
+
+// Copies the corners a mapped record points to, rejecting records that point outside the file
+bool CornerCache::readMapped(const Record& record, CachedCorners& entry) const {
+	size_t bytes = (size_t) record.pointCount * sizeof(Point2f);
+	if (record.offset > mappedSize || bytes > mappedSize - record.offset) return false;
+
+	entry.found = record.found != 0;
+	entry.imageSize = Size(record.width, record.height);
+	const Point2f* points = (const Point2f*) (mapped + record.offset);
+	entry.corners.assign(points, points + record.pointCount);
+	return true;
+}
+
+// Finds the detection result stored for key; results inserted since opening take precedence over the file
+// Holds the lock for the binary search too: save() replaces the mapping under it
+bool CornerCache::lookup(uint64_t key, CachedCorners& entry) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = pending.find(key);
+	if (found != pending.end()) {
+		entry = found->second;
+		return true;
+	}
+
+	const Record* end = records + recordCount;
+	const Record* it = std::lower_bound(records, end, key, [](const Record& r, uint64_t k) { return r.key < k; });
+	if (it == end || it->key != key) return false;
+	return readMapped(*it, entry);
+}
+
+// Remembers a detection result; safe to call from several detector threads at once
+void CornerCache::insert(uint64_t key, const CachedCorners& entry) {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending[key] = entry;
+}
+
+// Writes the mapped entries and the pending ones to a fresh file and maps that file
+bool CornerCache::save() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pending.empty()) return true;
+
+	// Merge the mapped entries that were not replaced into the pending ones, which keeps everything sorted by key
+	std::map<uint64_t, CachedCorners> merged = pending;
+	for (size_t i = 0; i < recordCount; i++) {
+		CachedCorners entry;
+		if (!merged.count(records[i].key) && readMapped(records[i], entry)) merged[records[i].key] = entry;
+	}
+
+	Header header;
+	memcpy(header.magic, cornerCacheMagic, 4);
+	header.version = cornerCacheVersion;
+	header.recordCount = merged.size();
+
+	std::vector<Record> index;
+	index.reserve(merged.size());
+	uint64_t offset = sizeof(Header) + merged.size() * sizeof(Record);
+	for (const auto& item : merged) {
+		Record record;
+		record.key = item.first;
+		record.offset = offset;
+		record.found = item.second.found ? 1 : 0;
+		record.pointCount = (uint32_t) item.second.corners.size();
+		record.width = item.second.imageSize.width;
+		record.height = item.second.imageSize.height;
+		index.push_back(record);
+		offset += record.pointCount * sizeof(Point2f);
+	}
+
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write((const char*) &header, sizeof(header));
+		file.write((const char*) index.data(), index.size() * sizeof(Record));
+		for (const auto& item : merged) {
+			file.write((const char*) item.second.corners.data(), item.second.corners.size() * sizeof(Point2f));
+		}
+		if (!file) {
+			printf("Could not write corner cache %s\n", temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	// The old file has to be unmapped before it can be replaced
+	unmap();
+	std::remove(path.c_str());
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		printf("Could not replace corner cache %s\n", path.c_str());
+		return false;
+	}
+	pending.clear();
+	return map();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Detection result of a single image as stored in the corner cache
+struct CachedCorners
+{
+	bool found = false;
+	cv::Size imageSize; // full-resolution size of the image the corners were found in
+	std::vector<cv::Point2f> corners;
+};
+
+// On-disk cache of chessboard corners per image, keyed by file contents and detection settings (see cornerCacheKey)
+// The cache file is memory-mapped when the cache is opened, so looking up thousands of views costs a single read;
+// new results are kept in memory until save() merges them into the file
+class CornerCache
+{
+public:
+	explicit CornerCache(const std::string& path);
+	~CornerCache();
+
+	bool lookup(uint64_t key, CachedCorners& entry) const;
+	void insert(uint64_t key, const CachedCorners& entry);
+	bool save();
+
+private:
+	// Fixed-size index record; the index is sorted by key and followed by the corner data
+	struct Record
+	{
+		uint64_t key;
+		uint64_t offset; // byte offset of the first corner from the start of the file
+		uint32_t found;
+		uint32_t pointCount;
+		int32_t width, height;
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t recordCount;
+	};
+
+	static_assert(sizeof(Record) == 32 && sizeof(Header) == 16, "The cache file layout must not depend on padding");
+
+	bool map();
+	void unmap();
+	bool readMapped(const Record& record, CachedCorners& entry) const;
+
+	std::string path;
+	const unsigned char* mapped = nullptr;
+	size_t mappedSize = 0;
+	const Record* records = nullptr;
+	size_t recordCount = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+
+	mutable std::mutex mutex;
+	std::map<uint64_t, CachedCorners> pending;
+};
+
+uint64_t cornerCacheKey(const std::string& imagePath, cv::Size boardSize, const DetectionOptions& options);
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Decodes a calibration image in the form the detector wants it
+// scale receives the number of full-resolution pixels per decoded pixel, which is 1 unless the decoder downscaled
+cv::Mat decodeForDetection(const std::string& path, const DetectionOptions& options, double& scale) {
+	scale = 1.0;
+	if (options.reducedDecode && !options.refine && options.pyramidLevels > 0) {
+		static const int reducedModes[] = { IMREAD_REDUCED_GRAYSCALE_2, IMREAD_REDUCED_GRAYSCALE_4, IMREAD_REDUCED_GRAYSCALE_8 };
+		int level = std::min(options.pyramidLevels, 3);
+		scale = (double) (1 << level);
+		return imread(path, reducedModes[level - 1]);
+	}
+	return imread(path, options.grayscaleDecode ? IMREAD_GRAYSCALE : IMREAD_COLOR);
+}
+
+// Runs the detector the options select on one pyramid level
+static bool findBoardCorners(const cv::Mat& image, cv::Size boardSize, std::vector<Point2f>& corners, const DetectionOptions& options) {
+	if (options.detector != DETECTOR_SADDLE) return findChessboardCorners(image, boardSize, corners, options.flags);
+	if (image.channels() == 1) return findChessboardSaddles(image, boardSize, corners, options.saddle);
+	Mat gray;
+	cvtColor(image, gray, COLOR_BGR2GRAY);
+	return findChessboardSaddles(gray, boardSize, corners, options.saddle);
+}
+
+// Finds the inner corners of a chess board, coarse-to-fine when options.pyramidLevels > 0
+// image may be color or grayscale; scale maps its pixel coordinates to full resolution (see decodeForDetection)
+bool detectChessboard(const cv::Mat& image, double scale, cv::Size boardSize, std::vector<Point2f>& corners, const DetectionOptions& options) {
+	// The image the decoder already reduced is the coarse level itself
+	int levels = scale > 1.0 ? 0 : options.pyramidLevels;
+	if (levels == 0 && !options.refine) {
+		bool found = findBoardCorners(image, boardSize, corners, options);
+		if (found && scale != 1.0) {
+			for (Point2f& p : corners) p = Point2f((float) ((p.x + 0.5) * scale - 0.5), (float) ((p.y + 0.5) * scale - 0.5));
+		}
+		return found;
+	}
+
+	Mat gray;
+	if (image.channels() == 1) gray = image;
+	else cvtColor(image, gray, COLOR_BGR2GRAY);
+
+	// Search the board on the coarsest level
+	Mat coarse = gray;
+	for (int level = 0; level < levels; level++) {
+		Mat next;
+		pyrDown(coarse, next);
+		coarse = next;
+	}
+	if (!findBoardCorners(coarse, boardSize, corners, options)) return false;
+
+	// Map the corners back to full resolution; pixel centers line up at (x + 0.5) * 2^levels - 0.5
+	float factor = (float) (1 << levels);
+	for (Point2f& p : corners) p = Point2f((p.x + 0.5f) * factor - 0.5f, (p.y + 0.5f) * factor - 0.5f);
+
+	if (options.refine) {
+		// The search window has to stay inside one square, so it is derived from the corner spacing
+		RefinementOptions refinement;
+		refinement.maxIterations = 30;
+		refineCorners(gray, corners, refinement);
+	}
+	return true;
+}
+
+// Predicts where the board will appear from a calibration and a recent board pose
+// The outline includes the outer row of squares, because findChessboardCorners needs the whole board and a bit of
+// the background around it; margin then widens the box by that fraction of its size to allow for motion
+// Returns an empty rectangle when the board is behind the camera or outside the frame
+cv::Rect predictBoardRegion(const Intrinsics& intrinsics, const Extrinsics& pose, cv::Size boardSize, float squareEdgeLength, cv::Size imageSize, double margin) {
+	float left = -squareEdgeLength, top = -squareEdgeLength;
+	float right = boardSize.width * squareEdgeLength, bottom = boardSize.height * squareEdgeLength;
+	std::vector<Point3f> outline = { Point3f(left, top, 0.0f), Point3f(right, top, 0.0f), Point3f(right, bottom, 0.0f), Point3f(left, bottom, 0.0f) };
+
+	// projectPoints happily projects points behind the camera, so check depth first
+	cv::Matx33d R = rotationVectorToMatx(cv::Vec3d(pose.r));
+	cv::Vec3d t(pose.t);
+	for (const Point3f& p : outline) {
+		if ((R * cv::Vec3d(p.x, p.y, p.z) + t)[2] <= 0.0) return Rect();
+	}
+
+	std::vector<Point2f> projected;
+	projectPoints(outline, pose.r, pose.t, intrinsics.K, intrinsics.D, projected);
+	Rect box = boundingRect(projected);
+	int padX = (int) (box.width * margin), padY = (int) (box.height * margin);
+	box = Rect(box.x - padX, box.y - padY, box.width + 2 * padX, box.height + 2 * padY);
+	return box & Rect(Point(0, 0), imageSize);
+}
+
+// Searches the board only inside region of a full-resolution image and returns the corners in full-frame coordinates
+// The crop is a view into image, so the cost follows the size of the region rather than the size of the frame
+bool detectChessboardInRegion(const cv::Mat& image, cv::Rect region, cv::Size boardSize, std::vector<Point2f>& corners, const DetectionOptions& options) {
+	region &= Rect(0, 0, image.cols, image.rows);
+	if (region.width < 2 * boardSize.width || region.height < 2 * boardSize.height) return false;
+
+	TRACE_SCOPE("detectChessboardInRegion");
+	if (!detectChessboard(image(region), 1.0, boardSize, corners, options)) return false;
+	Point2f offset((float) region.x, (float) region.y);
+	for (Point2f& p : corners) p += offset;
+	return true;
+}
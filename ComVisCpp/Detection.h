@@ -0,0 +1,27 @@
+#pragma once
+
+// Corner detectors detectChessboard can run
+enum ChessboardDetector
+{
+	DETECTOR_OPENCV, // cv::findChessboardCorners: quads from dilated adaptive thresholds
+	DETECTOR_SADDLE  // findChessboardSaddles: saddle-point filter and grid assembly, faster and more tolerant of blur
+};
+
+// Controls how the chessboard is searched for in a calibration image
+// With pyramidLevels > 0 the board is found on an image downscaled by 2^pyramidLevels and the corners are mapped back
+// to full resolution, where refine polishes them with refineCorners
+struct DetectionOptions
+{
+	bool grayscaleDecode = true; // decode straight to one channel instead of BGR
+	bool reducedDecode = false;  // let the JPEG decoder produce the coarse level (DCT-domain scaling); only used without refine
+	int pyramidLevels = 0;       // 0 searches at full resolution, 1 at half, 2 at quarter
+	bool refine = false;         // refine the corners at full resolution with refineCorners
+	int flags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE + cv::CALIB_CB_FAST_CHECK; // for DETECTOR_OPENCV
+	ChessboardDetector detector = DETECTOR_OPENCV;
+	SaddleOptions saddle;        // for DETECTOR_SADDLE
+};
+
+cv::Mat decodeForDetection(const std::string& path, const DetectionOptions& options, double& scale);
+bool detectChessboard(const cv::Mat& image, double scale, cv::Size boardSize, std::vector<cv::Point2f>& corners, const DetectionOptions& options);
+cv::Rect predictBoardRegion(const Intrinsics& intrinsics, const Extrinsics& pose, cv::Size boardSize, float squareEdgeLength, cv::Size imageSize, double margin = 0.25);
+bool detectChessboardInRegion(const cv::Mat& image, cv::Rect region, cv::Size boardSize, std::vector<cv::Point2f>& corners, const DetectionOptions& options);
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Starts at the baseline, which every CPU runs, so the table is usable even before the startup selection below
+KernelTable kernels = {
+	ISA_BASELINE,
+	kernels_baseline::projectView,
+	kernels_baseline::smoothRows,
+	kernels_baseline::smoothColumns,
+	kernels_baseline::saddleResponse
+};
+
+// The variants of one instruction set
+static KernelTable kernelTable(CpuIsa isa) {
+#if COMVIS_AVX2_KERNELS
+	if (isa == ISA_AVX2) return KernelTable{ ISA_AVX2, kernels_avx2::projectView, kernels_avx2::smoothRows, kernels_avx2::smoothColumns, kernels_avx2::saddleResponse };
+#endif
+	return KernelTable{ ISA_BASELINE, kernels_baseline::projectView, kernels_baseline::smoothRows, kernels_baseline::smoothColumns, kernels_baseline::saddleResponse };
+}
+
+const char* isaName(CpuIsa isa) {
+	return isa == ISA_AVX2 ? "avx2" : "baseline";
+}
+
+// Best instruction set of this CPU that the kernels are compiled for
+// Goes through cv::checkHardwareSupport, which also asks the OS whether it saves the AVX registers, so
+// cv::setUseOptimized(false) turns these kernels back to the baseline along with OpenCV's own
+CpuIsa detectCpuIsa() {
+#if COMVIS_AVX2_KERNELS
+	if (checkHardwareSupport(CV_CPU_AVX2) && checkHardwareSupport(CV_CPU_FMA3)) return ISA_AVX2;
+#endif
+	return ISA_BASELINE;
+}
+
+// Binds the kernels of isa; refuses an instruction set the CPU lacks, which would fault on the first call
+// Meant for startup and benchmarks: a kernel that is already running keeps the variant it started with
+bool selectIsa(CpuIsa isa) {
+	if (isa > detectCpuIsa()) {
+		printf("This CPU cannot run the %s kernels, keeping %s\n", isaName(isa), isaName(kernels.isa));
+		return false;
+	}
+	kernels = kernelTable(isa);
+	return true;
+}
+
+// Selects by name: "baseline", "avx2", or "native" for the best the CPU runs
+bool selectIsa(const std::string& name) {
+	if (name == "native") return selectIsa(detectCpuIsa());
+	for (CpuIsa isa : { ISA_BASELINE, ISA_AVX2 }) {
+		if (name == isaName(isa)) return selectIsa(isa);
+	}
+	printf("Unknown instruction set %s, keeping %s\n", name.c_str(), isaName(kernels.isa));
+	return false;
+}
+
+// Binds the best variants before main runs; COMVIS_ISA forces one, and --isa can still change it
+static bool bindStartupKernels() {
+	const char* forced = getenv("COMVIS_ISA");
+	if (forced && selectIsa(std::string(forced))) return true;
+	return selectIsa(detectCpuIsa());
+}
+
+static bool startupKernelsBound = bindStartupKernels();
\ No newline at end of file
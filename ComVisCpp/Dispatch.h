@@ -0,0 +1,25 @@
+#pragma once
+
+// Instruction sets the kernels of Kernels.h are compiled for, from the portable baseline up
+enum CpuIsa
+{
+	ISA_BASELINE, // universal intrinsics
+	ISA_AVX2      // AVX2 and FMA3; also what AVX-512 machines run
+};
+
+// The kernel variants in use; bound at startup, callers go through these pointers
+struct KernelTable
+{
+	CpuIsa isa;
+	void (*projectView)(const ProjectionModel& m, const double* R, const double* t, const double* X, const double* Y, const double* Z, size_t n, double* u, double* v);
+	void (*smoothRows)(const float* src, float* dst, int width, int height);
+	void (*smoothColumns)(const float* src, float* dst, int width, int height);
+	float (*saddleResponse)(const float* image, float* response, int width, int height);
+};
+
+extern KernelTable kernels;
+
+const char* isaName(CpuIsa isa);
+CpuIsa detectCpuIsa();
+bool selectIsa(CpuIsa isa);
+bool selectIsa(const std::string& name);
\ No newline at end of file
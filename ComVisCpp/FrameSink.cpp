@@ -0,0 +1,84 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+void WindowSink::write(const std::string& name, const cv::Mat& frame) {
+	imshow(name, frame);
+	waitKey(0);
+}
+
+ImageFileSink::ImageFileSink(const std::string& directory, const std::string& extension) : directory(directory), extension(extension) {
+}
+
+void ImageFileSink::write(const std::string& name, const cv::Mat& frame) {
+	std::string fileName = name;
+	std::replace(fileName.begin(), fileName.end(), ' ', '_');
+	std::string path = directory + "/" + fileName + "_" + to_string(frameCount++) + "." + extension;
+	if (!imwrite(path, frame)) printf("Could not write %s\n", path.c_str());
+}
+
+VideoFileSink::VideoFileSink(const std::string& path, double fps, int fourcc) : path(path), fps(fps), fourcc(fourcc) {
+}
+
+void VideoFileSink::write(const std::string&, const cv::Mat& frame) {
+	if (!writer.isOpened()) {
+		if (!writer.open(path, fourcc, fps, frame.size(), frame.channels() == 3)) {
+			printf("Could not open %s for writing\n", path.c_str());
+			return;
+		}
+	}
+	writer.write(frame);
+}
+
+AsyncSink::AsyncSink(std::unique_ptr<FrameSink> target, size_t queueDepth, bool dropWhenFull) : target(std::move(target)), queue(queueDepth), dropWhenFull(dropWhenFull) {
+	worker = std::thread([this]() {
+		NamedFrame item;
+		while (queue.pop(item)) {
+			TRACE_SCOPE("sink write");
+			this->target->write(item.name, item.frame);
+			item.frame.release();
+		}
+	});
+}
+
+// Writes out the frames that are still queued before the target sink goes away
+AsyncSink::~AsyncSink() {
+	queue.close();
+	worker.join();
+}
+
+void AsyncSink::write(const std::string& name, const cv::Mat& frame) {
+	NamedFrame item{ name, frame };
+	if (dropWhenFull) {
+		if (!queue.tryPush(std::move(item))) dropped++;
+	}
+	else queue.push(std::move(item));
+}
+
+// Creates a sink from a short description:
+//   window             show every frame and wait for a key (the default)
+//   none               discard every frame
+//   images:<dir>[:png] write every frame to its own file in an existing directory, jpg unless given
+//   video:<file>       write all frames to one MJPG video
+// File sinks write on a background thread
+std::unique_ptr<FrameSink> makeFrameSink(const std::string& spec) {
+	if (spec == "none") return std::unique_ptr<FrameSink>(new NullSink());
+
+	if (spec.compare(0, 7, "images:") == 0) {
+		std::string directory = spec.substr(7), extension = "jpg";
+		size_t separator = directory.rfind(':');
+		if (separator != std::string::npos && separator > 1) { // Skip the colon of a Windows drive letter
+			extension = directory.substr(separator + 1);
+			directory = directory.substr(0, separator);
+		}
+		return std::unique_ptr<FrameSink>(new AsyncSink(std::unique_ptr<FrameSink>(new ImageFileSink(directory, extension))));
+	}
+
+	if (spec.compare(0, 6, "video:") == 0) {
+		return std::unique_ptr<FrameSink>(new AsyncSink(std::unique_ptr<FrameSink>(new VideoFileSink(spec.substr(6)))));
+	}
+
+	if (spec != "window") printf("Unknown output %s, showing frames in a window instead\n", spec.c_str());
+	return std::unique_ptr<FrameSink>(new WindowSink());
+}
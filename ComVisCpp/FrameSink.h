@@ -0,0 +1,76 @@
+#pragma once
+
+// Destination for annotated frames, so the draw functions do not depend on a display
+// Sinks may keep a reference to the pixels, so a frame must not be modified after it was written
+class FrameSink
+{
+public:
+	virtual ~FrameSink() {}
+	virtual void write(const std::string& name, const cv::Mat& frame) = 0;
+};
+
+// Shows every frame in a window and waits for a key press, like the draw functions used to
+class WindowSink : public FrameSink
+{
+public:
+	void write(const std::string& name, const cv::Mat& frame) override;
+};
+
+// Discards every frame
+class NullSink : public FrameSink
+{
+public:
+	void write(const std::string&, const cv::Mat&) override {}
+};
+
+// Encodes every frame to its own file, <directory>/<name>_<n>.<extension>
+class ImageFileSink : public FrameSink
+{
+public:
+	ImageFileSink(const std::string& directory, const std::string& extension = "jpg");
+	void write(const std::string& name, const cv::Mat& frame) override;
+
+private:
+	std::string directory, extension;
+	size_t frameCount = 0;
+};
+
+// Appends every frame to one video file, which is opened with the size of the first frame
+class VideoFileSink : public FrameSink
+{
+public:
+	VideoFileSink(const std::string& path, double fps = 30.0, int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+	void write(const std::string& name, const cv::Mat& frame) override;
+
+private:
+	std::string path;
+	double fps;
+	int fourcc;
+	cv::VideoWriter writer;
+};
+
+// Hands frames to another sink on a background thread, so encoding and disk writes never stall the caller
+// When the queue is full, write either waits or drops the frame, depending on dropWhenFull
+class AsyncSink : public FrameSink
+{
+public:
+	AsyncSink(std::unique_ptr<FrameSink> target, size_t queueDepth = 8, bool dropWhenFull = false);
+	~AsyncSink();
+	void write(const std::string& name, const cv::Mat& frame) override;
+	size_t droppedFrames() const { return dropped; }
+
+private:
+	struct NamedFrame
+	{
+		std::string name;
+		cv::Mat frame;
+	};
+
+	std::unique_ptr<FrameSink> target;
+	BoundedQueue<NamedFrame> queue;
+	const bool dropWhenFull;
+	std::atomic<size_t> dropped{ 0 };
+	std::thread worker;
+};
+
+std::unique_ptr<FrameSink> makeFrameSink(const std::string& spec);
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Streams calibration images from disk into the corner detector
+// A single decode thread fills a queue of at most queueDepth frames that workerCount detector threads drain,
+// so no more than queueDepth + workerCount frames are alive at once regardless of how many paths are given
+// Images found in cornerCache skip decoding and detection altogether, the others are added to it
+// Returns the size of the decoded images, which calibrateCamera needs
+cv::Size getChessboardCornersStreaming(const std::vector<std::string>& imagePaths, cv::Size boardSize, std::vector<std::vector<Point2f>>& allFoundPoints, std::vector<size_t>* foundIndices, const DetectionOptions& options, size_t queueDepth, unsigned workerCount, CornerCache* cornerCache) {
+	if (workerCount == 0) { // Leave one hardware thread for the decoder
+		unsigned hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	BoundedQueue<StreamedImage> queue(queueDepth);
+	std::vector<std::vector<Point2f>> pointBuffers(imagePaths.size());
+	std::vector<char> patternFound(imagePaths.size(), 0);
+	std::vector<Size> imageSizes(imagePaths.size()); // full-resolution size of every image, each written by one thread
+
+	// Decode stage
+	std::thread decoder([&]() {
+		for (size_t i = 0; i < imagePaths.size(); i++) {
+			TRACE_SCOPE("decode");
+			uint64_t cacheKey = 0;
+			if (cornerCache) {
+				CachedCorners cached;
+				cacheKey = cornerCacheKey(imagePaths[i], boardSize, options);
+				if (cornerCache->lookup(cacheKey, cached)) {
+					patternFound[i] = cached.found;
+					pointBuffers[i] = std::move(cached.corners);
+					imageSizes[i] = cached.imageSize;
+					continue;
+				}
+			}
+
+			double scale;
+			Mat image = decodeForDetection(imagePaths[i], options, scale);
+			if (image.empty()) {
+				printf("Could not read %s\n", imagePaths[i].c_str());
+				continue;
+			}
+			if (!queue.push(StreamedImage{ i, image, scale, cacheKey })) break;
+		}
+		queue.close();
+	});
+
+	// Detection stage; every frame is released as soon as its corners are extracted
+	auto detector = [&]() {
+		StreamedImage frame;
+		while (queue.pop(frame)) {
+			TRACE_SCOPE("detect");
+			patternFound[frame.index] = detectChessboard(frame.image, frame.scale, boardSize, pointBuffers[frame.index], options);
+			Size imageSize(cvRound(frame.image.cols * frame.scale), cvRound(frame.image.rows * frame.scale));
+			imageSizes[frame.index] = imageSize;
+			if (cornerCache) {
+				CachedCorners result;
+				result.found = patternFound[frame.index] != 0;
+				result.imageSize = imageSize;
+				result.corners = pointBuffers[frame.index];
+				cornerCache->insert(frame.cacheKey, result);
+			}
+			frame.image.release();
+		}
+	};
+	std::vector<std::thread> detectors;
+	for (unsigned w = 0; w < workerCount; w++) detectors.emplace_back(detector);
+
+	decoder.join();
+	for (std::thread& t : detectors) t.join();
+
+	Size imageSize;
+	for (size_t i = 0; i < imagePaths.size(); i++) {
+		if (imageSize.area() == 0) imageSize = imageSizes[i];
+		if (!patternFound[i]) continue;
+		allFoundPoints.push_back(std::move(pointBuffers[i]));
+		if (foundIndices) foundIndices->push_back(i);
+	}
+	return imageSize;
+}
+
+// Calibrates the camera from image files without holding the whole data set in memory
+// The view indices of the result refer to positions in imagePaths
+CalibrationResult cameraCalibrationStreaming(const std::vector<std::string>& imagePaths, cv::Size boardSize, float squareEdgeLength, const DetectionOptions& options, size_t queueDepth, unsigned workerCount, CornerCache* cornerCache) {
+	vector<vector<Point2f>> foundPoints;
+	vector<size_t> foundIndices;
+	Size imageSize = getChessboardCornersStreaming(imagePaths, boardSize, foundPoints, &foundIndices, options, queueDepth, workerCount, cornerCache);
+
+	CalibrationResult result = outlierRejection.enabled
+		? calibrateRejectingOutliers(foundPoints, imageSize, boardSize, squareEdgeLength, outlierRejection, workerCount)
+		: calibrateFromCorners(foundPoints, imageSize, boardSize, squareEdgeLength, nullptr, 30, workerCount);
+	for (size_t& index : result.viewIndices) index = foundIndices[index];
+	return result;
+}
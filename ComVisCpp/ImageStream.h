@@ -0,0 +1,13 @@
+#pragma once
+
+// A decoded calibration image together with its position in the input list
+struct StreamedImage
+{
+	size_t index;
+	cv::Mat image;
+	double scale; // full-resolution pixels per decoded pixel
+	uint64_t cacheKey; // key of the image in the corner cache, if one is used
+};
+
+cv::Size getChessboardCornersStreaming(const std::vector<std::string>& imagePaths, cv::Size boardSize, std::vector<std::vector<cv::Point2f>>& allFoundPoints, std::vector<size_t>* foundIndices = nullptr, const DetectionOptions& options = DetectionOptions(), size_t queueDepth = 4, unsigned workerCount = 0, CornerCache* cornerCache = nullptr);
+CalibrationResult cameraCalibrationStreaming(const std::vector<std::string>& imagePaths, cv::Size boardSize, float squareEdgeLength, const DetectionOptions& options = DetectionOptions(), size_t queueDepth = 4, unsigned workerCount = 0, CornerCache* cornerCache = nullptr);
\ No newline at end of file
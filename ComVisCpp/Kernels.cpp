@@ -0,0 +1,151 @@
+#include "pch.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+using namespace std;
+using namespace cv;
+
+namespace kernels_baseline
+{
+
+// Projects points [begin, end) of one view with the same model as cv::projectPoints (rational radial and tangential
+// distortion); this is the scalar reference and handles whatever the vector loop leaves over
+// R is row major, like Matx33d::val
+static void projectViewScalar(const ProjectionModel& m, const double* R, const double* t, const double* X, const double* Y, const double* Z, size_t begin, size_t end, double* u, double* v) {
+	const double* k = m.k;
+	for (size_t i = begin; i < end; i++) {
+		double xc = R[0] * X[i] + R[1] * Y[i] + R[2] * Z[i] + t[0];
+		double yc = R[3] * X[i] + R[4] * Y[i] + R[5] * Z[i] + t[1];
+		double zc = R[6] * X[i] + R[7] * Y[i] + R[8] * Z[i] + t[2];
+		double iz = 1.0 / zc;
+		double x = xc * iz, y = yc * iz;
+
+		double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+		double radial = (1 + k[0] * r2 + k[1] * r4 + k[4] * r6) / (1 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+		double a1 = 2 * x * y, a2 = r2 + 2 * x * x, a3 = r2 + 2 * y * y;
+		double xd = x * radial + k[2] * a1 + k[3] * a2;
+		double yd = y * radial + k[2] * a3 + k[3] * a1;
+
+		u[i] = m.fx * xd + m.cx;
+		v[i] = m.fy * yd + m.cy;
+	}
+}
+
+// Projects the n points of one view, two at a time with the universal intrinsics where the platform has them
+void projectView(const ProjectionModel& m, const double* R, const double* t, const double* X, const double* Y, const double* Z, size_t n, double* u, double* v) {
+	size_t i = 0;
+
+#if CV_SIMD128_64F
+	const v_float64x2 r00 = v_setall_f64(R[0]), r01 = v_setall_f64(R[1]), r02 = v_setall_f64(R[2]);
+	const v_float64x2 r10 = v_setall_f64(R[3]), r11 = v_setall_f64(R[4]), r12 = v_setall_f64(R[5]);
+	const v_float64x2 r20 = v_setall_f64(R[6]), r21 = v_setall_f64(R[7]), r22 = v_setall_f64(R[8]);
+	const v_float64x2 t0 = v_setall_f64(t[0]), t1 = v_setall_f64(t[1]), t2 = v_setall_f64(t[2]);
+	const v_float64x2 k1 = v_setall_f64(m.k[0]), k2 = v_setall_f64(m.k[1]), p1 = v_setall_f64(m.k[2]), p2 = v_setall_f64(m.k[3]);
+	const v_float64x2 k3 = v_setall_f64(m.k[4]), k4 = v_setall_f64(m.k[5]), k5 = v_setall_f64(m.k[6]), k6 = v_setall_f64(m.k[7]);
+	const v_float64x2 fx = v_setall_f64(m.fx), fy = v_setall_f64(m.fy), cx = v_setall_f64(m.cx), cy = v_setall_f64(m.cy);
+	const v_float64x2 one = v_setall_f64(1.0), two = v_setall_f64(2.0);
+
+	for (; i + 2 <= n; i += 2) {
+		v_float64x2 px = v_load(X + i), py = v_load(Y + i), pz = v_load(Z + i);
+		v_float64x2 xc = r00 * px + r01 * py + r02 * pz + t0;
+		v_float64x2 yc = r10 * px + r11 * py + r12 * pz + t1;
+		v_float64x2 zc = r20 * px + r21 * py + r22 * pz + t2;
+		v_float64x2 iz = one / zc;
+		v_float64x2 x = xc * iz, y = yc * iz;
+
+		v_float64x2 r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+		v_float64x2 radial = (one + k1 * r2 + k2 * r4 + k3 * r6) / (one + k4 * r2 + k5 * r4 + k6 * r6);
+		v_float64x2 a1 = two * x * y, a2 = r2 + two * x * x, a3 = r2 + two * y * y;
+		v_float64x2 xd = x * radial + p1 * a1 + p2 * a2;
+		v_float64x2 yd = y * radial + p1 * a3 + p2 * a1;
+
+		v_store(u + i, fx * xd + cx);
+		v_store(v + i, fy * yd + cy);
+	}
+#endif
+
+	projectViewScalar(m, R, t, X, Y, Z, i, n, u, v);
+}
+
+// Horizontal pass of the separable binomial filter [1 4 6 4 1] / 16 over a width x height float image; borders replicate
+void smoothRows(const float* src, float* dst, int width, int height) {
+	for (int y = 0; y < height; y++) {
+		const float* s = src + (size_t) y * width;
+		float* t = dst + (size_t) y * width;
+		int x = 0;
+		for (; x < std::min(2, width); x++) {
+			t[x] = (s[std::max(x - 2, 0)] + s[std::min(x + 2, width - 1)] + 4.0f * (s[std::max(x - 1, 0)] + s[std::min(x + 1, width - 1)]) + 6.0f * s[x]) * (1.0f / 16.0f);
+		}
+#if CV_SIMD128
+		const v_float32x4 four = v_setall_f32(4.0f), six = v_setall_f32(6.0f), scale = v_setall_f32(1.0f / 16.0f);
+		for (; x + 4 <= width - 2; x += 4) {
+			v_float32x4 outer = v_load(s + x - 2) + v_load(s + x + 2);
+			v_float32x4 inner = v_load(s + x - 1) + v_load(s + x + 1);
+			v_store(t + x, (outer + four * inner + six * v_load(s + x)) * scale);
+		}
+#endif
+		for (; x < width; x++) {
+			t[x] = (s[std::max(x - 2, 0)] + s[std::min(x + 2, width - 1)] + 4.0f * (s[std::max(x - 1, 0)] + s[std::min(x + 1, width - 1)]) + 6.0f * s[x]) * (1.0f / 16.0f);
+		}
+	}
+}
+
+// Vertical pass of the same filter; src and dst must be different buffers
+void smoothColumns(const float* src, float* dst, int width, int height) {
+	for (int y = 0; y < height; y++) {
+		const float* r0 = src + (size_t) std::max(y - 2, 0) * width;
+		const float* r1 = src + (size_t) std::max(y - 1, 0) * width;
+		const float* r2 = src + (size_t) y * width;
+		const float* r3 = src + (size_t) std::min(y + 1, height - 1) * width;
+		const float* r4 = src + (size_t) std::min(y + 2, height - 1) * width;
+		float* d = dst + (size_t) y * width;
+		int x = 0;
+#if CV_SIMD128
+		const v_float32x4 four = v_setall_f32(4.0f), six = v_setall_f32(6.0f), scale = v_setall_f32(1.0f / 16.0f);
+		for (; x + 4 <= width; x += 4) {
+			v_float32x4 outer = v_load(r0 + x) + v_load(r4 + x);
+			v_float32x4 inner = v_load(r1 + x) + v_load(r3 + x);
+			v_store(d + x, (outer + four * inner + six * v_load(r2 + x)) * scale);
+		}
+#endif
+		for (; x < width; x++) d[x] = (r0[x] + r4[x] + 4.0f * (r1[x] + r3[x]) + 6.0f * r2[x]) * (1.0f / 16.0f);
+	}
+}
+
+// Saddle response Ixy^2 - Ixx * Iyy from central differences; the one pixel wide border is left at zero
+// Returns the strongest response
+float saddleResponse(const float* image, float* response, int width, int height) {
+	std::fill(response, response + (size_t) width * height, 0.0f);
+	float strongest = 0.0f;
+	for (int y = 1; y + 1 < height; y++) {
+		const float* above = image + (size_t) (y - 1) * width;
+		const float* row = image + (size_t) y * width;
+		const float* below = image + (size_t) (y + 1) * width;
+		float* r = response + (size_t) y * width;
+		int x = 1;
+#if CV_SIMD128
+		const v_float32x4 two = v_setall_f32(2.0f), quarter = v_setall_f32(0.25f);
+		v_float32x4 maxima = v_setzero_f32();
+		for (; x + 4 <= width - 1; x += 4) {
+			v_float32x4 center = v_load(row + x);
+			v_float32x4 ixx = v_load(row + x - 1) + v_load(row + x + 1) - two * center;
+			v_float32x4 iyy = v_load(above + x) + v_load(below + x) - two * center;
+			v_float32x4 ixy = (v_load(below + x + 1) - v_load(below + x - 1) - v_load(above + x + 1) + v_load(above + x - 1)) * quarter;
+			v_float32x4 value = ixy * ixy - ixx * iyy;
+			v_store(r + x, value);
+			maxima = v_max(maxima, value);
+		}
+		strongest = std::max(strongest, v_reduce_max(maxima));
+#endif
+		for (; x + 1 < width; x++) {
+			float ixx = row[x - 1] + row[x + 1] - 2.0f * row[x];
+			float iyy = above[x] + below[x] - 2.0f * row[x];
+			float ixy = (below[x + 1] - below[x - 1] - above[x + 1] + above[x - 1]) * 0.25f;
+			r[x] = ixy * ixy - ixx * iyy;
+			strongest = std::max(strongest, r[x]);
+		}
+	}
+	return strongest;
+}
+
+}
\ No newline at end of file
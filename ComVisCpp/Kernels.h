@@ -0,0 +1,42 @@
+#pragma once
+
+// Hand-written kernels, compiled once per instruction set; Dispatch.cpp binds the variant the CPU runs best
+// Every variant takes plain arrays only: the translation units built for a wider instruction set include nothing but
+// this header and the intrinsics, so no inline function of a shared header is ever compiled with their flags
+
+#include <cstddef>
+
+// The AVX2 variants only exist where the compiler targets x86
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define COMVIS_AVX2_KERNELS 1
+#else
+#define COMVIS_AVX2_KERNELS 0
+#endif
+
+// Camera model used by the batched projection kernel: pinhole intrinsics and up to 8 distortion coefficients
+// in OpenCV order (k1, k2, p1, p2, k3, k4, k5, k6); missing coefficients are zero
+struct ProjectionModel
+{
+	double fx, fy, cx, cy;
+	double k[8];
+};
+
+// Universal intrinsics (SSE2 on x86, NEON on ARM, scalar elsewhere): runs on every CPU the project supports
+namespace kernels_baseline
+{
+	void projectView(const ProjectionModel& m, const double* R, const double* t, const double* X, const double* Y, const double* Z, size_t n, double* u, double* v);
+	void smoothRows(const float* src, float* dst, int width, int height);
+	void smoothColumns(const float* src, float* dst, int width, int height);
+	float saddleResponse(const float* image, float* response, int width, int height);
+}
+
+#if COMVIS_AVX2_KERNELS
+// 256-bit AVX2 with FMA3
+namespace kernels_avx2
+{
+	void projectView(const ProjectionModel& m, const double* R, const double* t, const double* X, const double* Y, const double* Z, size_t n, double* u, double* v);
+	void smoothRows(const float* src, float* dst, int width, int height);
+	void smoothColumns(const float* src, float* dst, int width, int height);
+	float saddleResponse(const float* image, float* response, int width, int height);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+// AVX2 and FMA3 variants of the kernels in Kernels.h, eight floats or four doubles per instruction
+// Built with /arch:AVX2 or -mavx2 -mfma, so this file must not include pch.h or anything else with inline functions:
+// the linker keeps one copy of each, and a copy compiled here would fault on a CPU without AVX2
+
+#include "Kernels.h"
+
+#if COMVIS_AVX2_KERNELS
+
+#include <immintrin.h>
+
+namespace kernels_avx2
+{
+
+static inline int clampIndex(int i, int size) {
+	return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+// The same rational model as kernels_baseline::projectView, four points at a time with fused multiply-adds
+void projectView(const ProjectionModel& m, const double* R, const double* t, const double* X, const double* Y, const double* Z, size_t n, double* u, double* v) {
+	const __m256d r00 = _mm256_set1_pd(R[0]), r01 = _mm256_set1_pd(R[1]), r02 = _mm256_set1_pd(R[2]);
+	const __m256d r10 = _mm256_set1_pd(R[3]), r11 = _mm256_set1_pd(R[4]), r12 = _mm256_set1_pd(R[5]);
+	const __m256d r20 = _mm256_set1_pd(R[6]), r21 = _mm256_set1_pd(R[7]), r22 = _mm256_set1_pd(R[8]);
+	const __m256d t0 = _mm256_set1_pd(t[0]), t1 = _mm256_set1_pd(t[1]), t2 = _mm256_set1_pd(t[2]);
+	const __m256d k1 = _mm256_set1_pd(m.k[0]), k2 = _mm256_set1_pd(m.k[1]), p1 = _mm256_set1_pd(m.k[2]), p2 = _mm256_set1_pd(m.k[3]);
+	const __m256d k3 = _mm256_set1_pd(m.k[4]), k4 = _mm256_set1_pd(m.k[5]), k5 = _mm256_set1_pd(m.k[6]), k6 = _mm256_set1_pd(m.k[7]);
+	const __m256d fx = _mm256_set1_pd(m.fx), fy = _mm256_set1_pd(m.fy), cx = _mm256_set1_pd(m.cx), cy = _mm256_set1_pd(m.cy);
+	const __m256d one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d px = _mm256_loadu_pd(X + i), py = _mm256_loadu_pd(Y + i), pz = _mm256_loadu_pd(Z + i);
+		__m256d xc = _mm256_fmadd_pd(r00, px, _mm256_fmadd_pd(r01, py, _mm256_fmadd_pd(r02, pz, t0)));
+		__m256d yc = _mm256_fmadd_pd(r10, px, _mm256_fmadd_pd(r11, py, _mm256_fmadd_pd(r12, pz, t1)));
+		__m256d zc = _mm256_fmadd_pd(r20, px, _mm256_fmadd_pd(r21, py, _mm256_fmadd_pd(r22, pz, t2)));
+		__m256d iz = _mm256_div_pd(one, zc);
+		__m256d x = _mm256_mul_pd(xc, iz), y = _mm256_mul_pd(yc, iz);
+
+		// Horner form of 1 + k1 r^2 + k2 r^4 + k3 r^6 and its denominator
+		__m256d r2 = _mm256_fmadd_pd(x, x, _mm256_mul_pd(y, y));
+		__m256d numerator = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(k3, r2, k2), r2, k1), r2, one);
+		__m256d denominator = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(k6, r2, k5), r2, k4), r2, one);
+		__m256d radial = _mm256_div_pd(numerator, denominator);
+		__m256d a1 = _mm256_mul_pd(two, _mm256_mul_pd(x, y));
+		__m256d a2 = _mm256_fmadd_pd(two, _mm256_mul_pd(x, x), r2);
+		__m256d a3 = _mm256_fmadd_pd(two, _mm256_mul_pd(y, y), r2);
+		__m256d xd = _mm256_fmadd_pd(x, radial, _mm256_fmadd_pd(p1, a1, _mm256_mul_pd(p2, a2)));
+		__m256d yd = _mm256_fmadd_pd(y, radial, _mm256_fmadd_pd(p1, a3, _mm256_mul_pd(p2, a1)));
+
+		_mm256_storeu_pd(u + i, _mm256_fmadd_pd(fx, xd, cx));
+		_mm256_storeu_pd(v + i, _mm256_fmadd_pd(fy, yd, cy));
+	}
+
+	// The baseline takes the last few points; it is compiled without AVX, so calling it from here is safe
+	if (i < n) kernels_baseline::projectView(m, R, t, X + i, Y + i, Z + i, n - i, u + i, v + i);
+}
+
+// Horizontal pass of the binomial filter [1 4 6 4 1] / 16; borders replicate
+void smoothRows(const float* src, float* dst, int width, int height) {
+	const __m256 four = _mm256_set1_ps(4.0f), six = _mm256_set1_ps(6.0f), scale = _mm256_set1_ps(1.0f / 16.0f);
+	for (int y = 0; y < height; y++) {
+		const float* s = src + (size_t) y * width;
+		float* t = dst + (size_t) y * width;
+		int x = 0;
+		for (; x < 2 && x < width; x++) {
+			t[x] = (s[clampIndex(x - 2, width)] + s[clampIndex(x + 2, width)] + 4.0f * (s[clampIndex(x - 1, width)] + s[clampIndex(x + 1, width)]) + 6.0f * s[x]) * (1.0f / 16.0f);
+		}
+		for (; x + 8 <= width - 2; x += 8) {
+			__m256 outer = _mm256_add_ps(_mm256_loadu_ps(s + x - 2), _mm256_loadu_ps(s + x + 2));
+			__m256 inner = _mm256_add_ps(_mm256_loadu_ps(s + x - 1), _mm256_loadu_ps(s + x + 1));
+			__m256 sum = _mm256_fmadd_ps(six, _mm256_loadu_ps(s + x), _mm256_fmadd_ps(four, inner, outer));
+			_mm256_storeu_ps(t + x, _mm256_mul_ps(sum, scale));
+		}
+		for (; x < width; x++) {
+			t[x] = (s[clampIndex(x - 2, width)] + s[clampIndex(x + 2, width)] + 4.0f * (s[clampIndex(x - 1, width)] + s[clampIndex(x + 1, width)]) + 6.0f * s[x]) * (1.0f / 16.0f);
+		}
+	}
+}
+
+// Vertical pass of the same filter; src and dst must be different buffers
+void smoothColumns(const float* src, float* dst, int width, int height) {
+	const __m256 four = _mm256_set1_ps(4.0f), six = _mm256_set1_ps(6.0f), scale = _mm256_set1_ps(1.0f / 16.0f);
+	for (int y = 0; y < height; y++) {
+		const float* r0 = src + (size_t) clampIndex(y - 2, height) * width;
+		const float* r1 = src + (size_t) clampIndex(y - 1, height) * width;
+		const float* r2 = src + (size_t) y * width;
+		const float* r3 = src + (size_t) clampIndex(y + 1, height) * width;
+		const float* r4 = src + (size_t) clampIndex(y + 2, height) * width;
+		float* d = dst + (size_t) y * width;
+		int x = 0;
+		for (; x + 8 <= width; x += 8) {
+			__m256 outer = _mm256_add_ps(_mm256_loadu_ps(r0 + x), _mm256_loadu_ps(r4 + x));
+			__m256 inner = _mm256_add_ps(_mm256_loadu_ps(r1 + x), _mm256_loadu_ps(r3 + x));
+			__m256 sum = _mm256_fmadd_ps(six, _mm256_loadu_ps(r2 + x), _mm256_fmadd_ps(four, inner, outer));
+			_mm256_storeu_ps(d + x, _mm256_mul_ps(sum, scale));
+		}
+		for (; x < width; x++) d[x] = (r0[x] + r4[x] + 4.0f * (r1[x] + r3[x]) + 6.0f * r2[x]) * (1.0f / 16.0f);
+	}
+}
+
+// Saddle response Ixy^2 - Ixx * Iyy from central differences; the one pixel wide border is left at zero
+// Returns the strongest response
+float saddleResponse(const float* image, float* response, int width, int height) {
+	for (size_t i = 0, total = (size_t) width * height; i < total; i++) response[i] = 0.0f;
+	const __m256 two = _mm256_set1_ps(2.0f), quarter = _mm256_set1_ps(0.25f);
+	float strongest = 0.0f;
+	for (int y = 1; y + 1 < height; y++) {
+		const float* above = image + (size_t) (y - 1) * width;
+		const float* row = image + (size_t) y * width;
+		const float* below = image + (size_t) (y + 1) * width;
+		float* r = response + (size_t) y * width;
+		int x = 1;
+		__m256 maxima = _mm256_setzero_ps();
+		for (; x + 8 <= width - 1; x += 8) {
+			__m256 center = _mm256_loadu_ps(row + x);
+			__m256 ixx = _mm256_fnmadd_ps(two, center, _mm256_add_ps(_mm256_loadu_ps(row + x - 1), _mm256_loadu_ps(row + x + 1)));
+			__m256 iyy = _mm256_fnmadd_ps(two, center, _mm256_add_ps(_mm256_loadu_ps(above + x), _mm256_loadu_ps(below + x)));
+			__m256 diagonal = _mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(below + x + 1), _mm256_loadu_ps(below + x - 1)), _mm256_sub_ps(_mm256_loadu_ps(above + x + 1), _mm256_loadu_ps(above + x - 1)));
+			__m256 ixy = _mm256_mul_ps(diagonal, quarter);
+			__m256 value = _mm256_fmsub_ps(ixy, ixy, _mm256_mul_ps(ixx, iyy));
+			_mm256_storeu_ps(r + x, value);
+			maxima = _mm256_max_ps(maxima, value);
+		}
+		__m128 half = _mm_max_ps(_mm256_castps256_ps128(maxima), _mm256_extractf128_ps(maxima, 1));
+		half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+		half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+		float rowMax = _mm_cvtss_f32(half);
+		if (rowMax > strongest) strongest = rowMax;
+		for (; x + 1 < width; x++) {
+			float ixx = row[x - 1] + row[x + 1] - 2.0f * row[x];
+			float iyy = above[x] + below[x] - 2.0f * row[x];
+			float ixy = (below[x + 1] - below[x - 1] - above[x + 1] + above[x - 1]) * 0.25f;
+			r[x] = ixy * ixy - ixx * iyy;
+			if (r[x] > strongest) strongest = r[x];
+		}
+	}
+	return strongest;
+}
+
+}
+
+#endif
\ No newline at end of file
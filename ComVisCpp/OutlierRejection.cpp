@@ -0,0 +1,55 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Used by the calibration entry points; off unless the command line turns it on
+OutlierRejectionOptions outlierRejection;
+
+static double median(std::vector<double> values) {
+	if (values.empty()) return 0.0;
+	size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+	double upper = values[middle];
+	if (values.size() % 2) return upper;
+	return 0.5 * (upper + *std::max_element(values.begin(), values.begin() + middle));
+}
+
+// Error above which a view counts as an outlier: median + madFactor * 1.4826 * MAD, but at least minThreshold
+// Unlike mean and standard deviation, median and MAD barely move when a few views are far off
+double robustErrorThreshold(const std::vector<double>& viewErrors, const OutlierRejectionOptions& options) {
+	double center = median(viewErrors);
+	std::vector<double> deviations(viewErrors.size());
+	for (size_t i = 0; i < viewErrors.size(); i++) deviations[i] = std::abs(viewErrors[i] - center);
+	return std::max(options.minThreshold, center + options.madFactor * 1.4826 * median(deviations));
+}
+
+// Calibrates, then repeatedly drops the views whose error is an outlier and recalibrates the rest
+// Every recalibration starts from the intrinsics of the previous round, so it only has to absorb the change
+// The view indices of the result are positions in foundPoints
+CalibrationResult calibrateRejectingOutliers(const std::vector<std::vector<Point2f>>& foundPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, const OutlierRejectionOptions& options, unsigned workerCount) {
+	TRACE_SCOPE("calibrateRejectingOutliers");
+	std::vector<size_t> kept(foundPoints.size());
+	for (size_t i = 0; i < kept.size(); i++) kept[i] = i;
+	CalibrationResult result = calibrateFromCorners(foundPoints, imageSize, boardSize, squareEdgeLength, nullptr, 30, workerCount);
+
+	for (int round = 0; round < options.maxRounds; round++) {
+		double threshold = robustErrorThreshold(result.viewErrors, options);
+		std::vector<size_t> inliers;
+		for (size_t v = 0; v < kept.size(); v++) {
+			if (result.viewErrors[v] <= threshold) inliers.push_back(kept[v]);
+		}
+		if (inliers.size() == kept.size() || inliers.size() < options.minViews) break;
+		printf("Dropping %zu of %zu views above %.3f px\n", kept.size() - inliers.size(), kept.size(), threshold);
+
+		std::vector<std::vector<Point2f>> inlierPoints;
+		inlierPoints.reserve(inliers.size());
+		for (size_t index : inliers) inlierPoints.push_back(foundPoints[index]);
+		Intrinsics guess = result.intrinsics;
+		result = calibrateFromCorners(inlierPoints, imageSize, boardSize, squareEdgeLength, &guess, options.warmIterations, workerCount);
+		kept = std::move(inliers);
+	}
+
+	result.viewIndices = kept;
+	return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// Settings of the outlier view rejection
+// A view is dropped when its RMS reprojection error lies more than madFactor robust standard deviations (1.4826 times
+// the median absolute deviation) above the median of all views; the survivors are recalibrated, warm-started from
+// the previous K and D, until no view is dropped
+struct OutlierRejectionOptions
+{
+	bool enabled = false;
+	double madFactor = 3.0;
+	double minThreshold = 0.5; // views below this many pixels are never dropped, however tight the others fit
+	int maxRounds = 5;
+	size_t minViews = 6;       // stop dropping before fewer views than this remain
+	int warmIterations = 10;   // solver iterations of the warm-started recalibrations
+};
+
+extern OutlierRejectionOptions outlierRejection;
+
+double robustErrorThreshold(const std::vector<double>& viewErrors, const OutlierRejectionOptions& options);
+CalibrationResult calibrateRejectingOutliers(const std::vector<std::vector<cv::Point2f>>& foundPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, const OutlierRejectionOptions& options = outlierRejection, unsigned workerCount = 0);
\ No newline at end of file
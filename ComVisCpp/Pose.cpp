@@ -0,0 +1,165 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+BoardPoseEstimator::BoardPoseEstimator(cv::Size boardSize, float squareEdgeLength) {
+	createKnownBoardPosition(boardSize, squareEdgeLength, boardPoints);
+}
+
+// Finds the pose of the board in one frame from its corners; returns false when there is none
+// The previous pose is kept between calls, so a stream of frames only pays for the homography on the first one
+bool BoardPoseEstimator::estimate(const Intrinsics& intrinsics, const std::vector<Point2f>& corners, Extrinsics& pose) {
+	TRACE_SCOPE("estimatePose");
+	if (corners.size() != boardPoints.size()) return false;
+	if (warm) warmStarts++;
+	else {
+		Extrinsics start;
+		if (!planarPose(intrinsics, boardPoints, corners, start)) return false;
+		r = start.r;
+		t = start.t;
+		coldStarts++;
+	}
+
+	// The solver writes into r and t in place; a board behind the camera means it converged to the mirrored pose
+	warm = solvePnP(boardPoints, corners, intrinsics.K, intrinsics.D, r, t, true, SOLVEPNP_ITERATIVE) && t.at<double>(2) > 0.0;
+	if (!warm) return false;
+	pose.r = r.clone();
+	pose.t = t.clone();
+	return true;
+}
+
+// Normalized camera coordinates of a pixel, the inverse of the lens model by fixed-point iteration, as
+// undistortPoints does it
+static Vec2d undistortPixel(const SharedIntrinsics& p, const Point2f& pixel) {
+	double x0 = (pixel.x - p[2]) / p[0], y0 = (pixel.y - p[3]) / p[1];
+	double x = x0, y = y0;
+	for (int iteration = 0; iteration < 5; iteration++) {
+		double r2 = x * x + y * y;
+		double inverseRadial = 1.0 / (1.0 + ((p[8] * r2 + p[5]) * r2 + p[4]) * r2);
+		double dx = 2.0 * p[6] * x * y + p[7] * (r2 + 2.0 * x * x);
+		double dy = p[6] * (r2 + 2.0 * y * y) + 2.0 * p[7] * x * y;
+		x = (x0 - dx) * inverseRadial;
+		y = (y0 - dy) * inverseRadial;
+	}
+	return Vec2d(x, y);
+}
+
+// Sum of the squared reprojection errors of the board at pose R, t
+static double planarCost(const SharedIntrinsics& p, const std::vector<Point3f>& boardPoints, const std::vector<Point2f>& corners, const Matx33d& R, const Vec3d& t) {
+	double cost = 0.0;
+	for (size_t i = 0; i < boardPoints.size(); i++) {
+		Vec2d residual = projectDistorted(p, R * Vec3d(boardPoints[i].x, boardPoints[i].y, boardPoints[i].z) + t) - Vec2d(corners[i].x, corners[i].y);
+		cost += residual.dot(residual);
+	}
+	return cost;
+}
+
+// Closed-form pose of the planar board (z = 0) from the homography between the board plane and the undistorted corners
+// In normalized camera coordinates H ~ [r1 r2 t], so its first two columns scaled to unit length are two of the
+// rotation axes and the third is the translation. The homography is the linear least-squares fit with h33 = 1 on
+// centred and scaled coordinates, an 8 x 8 system for any number of corners, and all of it is fixed-size Matx math
+// Every refine step adds a Levenberg-Marquardt iteration on the reprojection error
+bool planarPose(const SharedIntrinsics& intrinsics, const std::vector<Point3f>& boardPoints, const std::vector<Point2f>& corners, cv::Matx33d& R, cv::Vec3d& t, int refineSteps) {
+	TRACE_SCOPE("planarPose");
+	size_t count = boardPoints.size();
+	if (count < 4 || corners.size() != count) return false;
+
+	// Centres and scales that bring both point sets to an RMS distance of sqrt(2) from the origin
+	Vec2d boardCentre, imageCentre;
+	double boardSquares = 0.0, imageSquares = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		Vec2d b(boardPoints[i].x, boardPoints[i].y), m = undistortPixel(intrinsics, corners[i]);
+		boardCentre += b;
+		imageCentre += m;
+		boardSquares += b.dot(b);
+		imageSquares += m.dot(m);
+	}
+	boardCentre *= 1.0 / count;
+	imageCentre *= 1.0 / count;
+	double boardSpread = boardSquares / count - boardCentre.dot(boardCentre), imageSpread = imageSquares / count - imageCentre.dot(imageCentre);
+	if (boardSpread <= 0.0 || imageSpread <= 0.0) return false;
+	double boardScale = sqrt(2.0 / boardSpread), imageScale = sqrt(2.0 / imageSpread);
+
+	// Normal equations of [X Y 1 0 0 0 -uX -uY] h = u and [0 0 0 X Y 1 -vX -vY] h = v
+	Matx<double, 8, 8> AtA;
+	Vec<double, 8> Atb;
+	for (size_t i = 0; i < count; i++) {
+		Vec2d b = (Vec2d(boardPoints[i].x, boardPoints[i].y) - boardCentre) * boardScale;
+		Vec2d m = (undistortPixel(intrinsics, corners[i]) - imageCentre) * imageScale;
+		Vec<double, 8> rowU(b[0], b[1], 1.0, 0.0, 0.0, 0.0, -m[0] * b[0], -m[0] * b[1]);
+		Vec<double, 8> rowV(0.0, 0.0, 0.0, b[0], b[1], 1.0, -m[1] * b[0], -m[1] * b[1]);
+		AtA += rowU * rowU.t() + rowV * rowV.t();
+		Atb += rowU * m[0] + rowV * m[1];
+	}
+	if (!choleskyFactor(AtA)) return false;
+	Vec<double, 8> h = choleskySolve(AtA, Atb);
+
+	// Undo the normalization: H = T_image^-1 * Hn * T_board
+	Matx33d normalizedH(h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], 1.0);
+	Matx33d boardTransform(boardScale, 0.0, -boardScale * boardCentre[0], 0.0, boardScale, -boardScale * boardCentre[1], 0.0, 0.0, 1.0);
+	Matx33d imageInverse(1.0 / imageScale, 0.0, imageCentre[0], 0.0, 1.0 / imageScale, imageCentre[1], 0.0, 0.0, 1.0);
+	Matx33d H = imageInverse * normalizedH * boardTransform;
+
+	Vec3d h1(H(0, 0), H(1, 0), H(2, 0)), h2(H(0, 1), H(1, 1), H(2, 1)), h3(H(0, 2), H(1, 2), H(2, 2));
+	double scale = 2.0 / (norm(h1) + norm(h2));
+	if (h3[2] < 0.0) scale = -scale; // the board is in front of the camera
+	Vec3d r1 = h1 * scale, r2 = h2 * scale, r3 = r1.cross(r2);
+	Matx33d columns(r1[0], r2[0], r3[0], r1[1], r2[1], r3[1], r1[2], r2[2], r3[2]);
+
+	// Noise leaves the columns slightly off orthonormal; U V^T of the SVD is the nearest rotation
+	Matx31d w;
+	Matx33d u, vt;
+	SVD::compute(columns, w, u, vt);
+	R = u * vt;
+	t = h3 * scale;
+
+	// The rotation is linearised as a small rotation applied after R, as in the calibration solvers
+	double cost = refineSteps > 0 ? planarCost(intrinsics, boardPoints, corners, R, t) : 0.0;
+	double lambda = 1e-3;
+	for (int step = 0; step < refineSteps; step++) {
+		Matx66d JtJ;
+		Vec6d gradient;
+		for (size_t i = 0; i < count; i++) {
+			Vec3d X = R * Vec3d(boardPoints[i].x, boardPoints[i].y, boardPoints[i].z);
+			Matx23d dPoint;
+			Vec2d residual = projectDistorted(intrinsics, X + t, &dPoint) - Vec2d(corners[i].x, corners[i].y);
+			Matx23d dRotation = dPoint * -Matx33d(0.0, -X[2], X[1], X[2], 0.0, -X[0], -X[1], X[0], 0.0);
+			Matx<double, 2, 6> J(
+				dRotation(0, 0), dRotation(0, 1), dRotation(0, 2), dPoint(0, 0), dPoint(0, 1), dPoint(0, 2),
+				dRotation(1, 0), dRotation(1, 1), dRotation(1, 2), dPoint(1, 0), dPoint(1, 1), dPoint(1, 2)
+			);
+			JtJ += J.t() * J;
+			gradient += J.t() * residual;
+		}
+
+		// A step that does not lower the error is retried with more damping, a few times at most
+		for (int attempt = 0; attempt < 4; attempt++, lambda *= 10.0) {
+			Matx66d damped = JtJ;
+			damp(damped, lambda);
+			if (!choleskyFactor(damped)) continue;
+			Vec6d delta = choleskySolve(damped, -gradient);
+			Matx33d candidateR = rotationVectorToMatx(Vec3d(delta[0], delta[1], delta[2])) * R;
+			Vec3d candidateT = t + Vec3d(delta[3], delta[4], delta[5]);
+			double candidateCost = planarCost(intrinsics, boardPoints, corners, candidateR, candidateT);
+			if (candidateCost < cost) {
+				R = candidateR;
+				t = candidateT;
+				cost = candidateCost;
+				lambda = std::max(lambda * 0.1, 1e-12);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+// planarPose for OpenCV intrinsics and extrinsics
+bool planarPose(const Intrinsics& intrinsics, const std::vector<Point3f>& boardPoints, const std::vector<Point2f>& corners, Extrinsics& pose, int refineSteps) {
+	Matx33d R;
+	Vec3d t;
+	if (!planarPose(toSharedIntrinsics(intrinsics), boardPoints, corners, R, t, refineSteps)) return false;
+	pose.r = Mat(rotationMatxToVector(R));
+	pose.t = Mat(t);
+	return true;
+}
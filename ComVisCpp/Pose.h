@@ -0,0 +1,25 @@
+#pragma once
+
+// Pose of the board in the frames of a calibrated camera, without calibrating
+// Each frame starts iterative solvePnP from the pose of the previous frame, which is already close, so the solver
+// converges in a few iterations; without a previous pose (the first frame, or after the board was lost) the start
+// comes from the closed-form planarPose instead
+class BoardPoseEstimator
+{
+public:
+	BoardPoseEstimator(cv::Size boardSize, float squareEdgeLength);
+
+	bool estimate(const Intrinsics& intrinsics, const std::vector<cv::Point2f>& corners, Extrinsics& pose);
+	void reset() { warm = false; }
+	bool isWarm() const { return warm; }
+
+	size_t coldStarts = 0, warmStarts = 0;
+
+private:
+	std::vector<cv::Point3f> boardPoints;
+	cv::Mat r, t; // pose of the previous frame
+	bool warm = false;
+};
+
+bool planarPose(const SharedIntrinsics& intrinsics, const std::vector<cv::Point3f>& boardPoints, const std::vector<cv::Point2f>& corners, cv::Matx33d& R, cv::Vec3d& t, int refineSteps = 0);
+bool planarPose(const Intrinsics& intrinsics, const std::vector<cv::Point3f>& boardPoints, const std::vector<cv::Point2f>& corners, Extrinsics& pose, int refineSteps = 0);
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Copies K and D into the flat form the projection kernel reads
+ProjectionModel makeProjectionModel(const Intrinsics& intrinsics) {
+	ProjectionModel model;
+	Matx33d K(intrinsics.K);
+	model.fx = K(0, 0);
+	model.fy = K(1, 1);
+	model.cx = K(0, 2);
+	model.cy = K(1, 2);
+
+	Mat D;
+	intrinsics.D.convertTo(D, CV_64F);
+	for (int i = 0; i < 8; i++) model.k[i] = i < (int) D.total() ? D.ptr<double>()[i] : 0.0;
+	return model;
+}
+
+PointsSoA makePointsSoA(const std::vector<cv::Point3f>& points) {
+	PointsSoA soa;
+	soa.x.reserve(points.size());
+	soa.y.reserve(points.size());
+	soa.z.reserve(points.size());
+	for (const Point3f& p : points) {
+		soa.x.push_back(p.x);
+		soa.y.push_back(p.y);
+		soa.z.push_back(p.z);
+	}
+	return soa;
+}
+
+// Projects the same object points into N views; u and v receive N * M coordinates, view after view
+// Views are split over workerCount threads in blocks, so small batches stay on the calling thread
+void projectPointsBatch(const ProjectionModel& model, Span<cv::Matx33d> rotations, Span<cv::Vec3d> translations, const PointsSoA& points, double* u, double* v, unsigned workerCount) {
+	const size_t viewsPerBlock = 64;
+	size_t viewCount = std::min(rotations.size(), translations.size());
+	size_t pointCount = points.size();
+	size_t blockCount = (viewCount + viewsPerBlock - 1) / viewsPerBlock;
+
+	parallelFor(blockCount, workerCount, [&](size_t block) {
+		size_t end = std::min(viewCount, (block + 1) * viewsPerBlock);
+		for (size_t view = block * viewsPerBlock; view < end; view++) {
+			kernels.projectView(model, rotations[view].val, translations[view].val, points.x.data(), points.y.data(), points.z.data(), pointCount, u + view * pointCount, v + view * pointCount);
+		}
+	});
+}
+
+// RMS distance in pixels between the detected corners of every view and the board reprojected with its pose
+void computeReprojectionErrors(const Intrinsics& intrinsics, Span<Extrinsics> extrinsics, const std::vector<std::vector<cv::Point2f>>& foundPoints, const std::vector<cv::Point3f>& boardPoints, std::vector<double>& viewErrors, unsigned workerCount) {
+	TRACE_SCOPE("computeReprojectionErrors");
+	size_t viewCount = extrinsics.size();
+	size_t pointCount = boardPoints.size();
+	viewErrors.assign(viewCount, 0.0);
+
+	if (backends.projection == PROJECTION_OPENCV) {
+		parallelFor(viewCount, workerCount, [&](size_t view) {
+			std::vector<Point2f> projected;
+			projectPoints(boardPoints, extrinsics[view].r, extrinsics[view].t, intrinsics.K, intrinsics.D, projected);
+			double error = norm(foundPoints[view], projected, NORM_L2);
+			viewErrors[view] = pointCount ? error / sqrt((double) pointCount) : 0.0;
+		});
+		return;
+	}
+
+	std::vector<Matx33d> rotations(viewCount);
+	std::vector<Vec3d> translations(viewCount);
+	for (size_t i = 0; i < viewCount; i++) {
+		rotations[i] = rotationVectorToMatx(Vec3d(extrinsics[i].r));
+		translations[i] = Vec3d(extrinsics[i].t);
+	}
+
+	std::vector<double> u(viewCount * pointCount), v(viewCount * pointCount);
+	projectPointsBatch(makeProjectionModel(intrinsics), rotations, translations, makePointsSoA(boardPoints), u.data(), v.data(), workerCount);
+
+	for (size_t view = 0; view < viewCount; view++) {
+		const std::vector<Point2f>& found = foundPoints[view];
+		double sum = 0.0;
+		for (size_t i = 0; i < pointCount; i++) {
+			double dx = u[view * pointCount + i] - found[i].x;
+			double dy = v[view * pointCount + i] - found[i].y;
+			sum += dx * dx + dy * dy;
+		}
+		viewErrors[view] = pointCount ? sqrt(sum / pointCount) : 0.0;
+	}
+}
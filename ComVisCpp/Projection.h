@@ -0,0 +1,14 @@
+#pragma once
+
+// Object points in structure-of-arrays layout, so the kernel can load several coordinates at once
+struct PointsSoA
+{
+	std::vector<double> x, y, z;
+
+	size_t size() const { return x.size(); }
+};
+
+ProjectionModel makeProjectionModel(const Intrinsics& intrinsics);
+PointsSoA makePointsSoA(const std::vector<cv::Point3f>& points);
+void projectPointsBatch(const ProjectionModel& model, Span<cv::Matx33d> rotations, Span<cv::Vec3d> translations, const PointsSoA& points, double* u, double* v, unsigned workerCount = 1);
+void computeReprojectionErrors(const Intrinsics& intrinsics, Span<Extrinsics> extrinsics, const std::vector<std::vector<cv::Point2f>>& foundPoints, const std::vector<cv::Point3f>& boardPoints, std::vector<double>& viewErrors, unsigned workerCount = 1);
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "pch.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+using namespace std;
+using namespace cv;
+
+// Corners are refined four at a time, one per vector lane. The windows of a group of four are stored interleaved
+// (sample after sample, each holding the four lanes), so the whole group is refined with vertical operations only
+
+// Search window half size for the corners of one view: it has to stay inside one square, and maxHalfWindow caps it
+// for callers that start close to the corners already
+int windowForSpacing(const std::vector<cv::Point2f>& corners, int maxHalfWindow) {
+	float spacing = corners.size() > 1 ? (float) norm(corners[1] - corners[0]) : 0.0f;
+	return std::max(2, std::min(maxHalfWindow, (int) (spacing * 0.4f)));
+}
+
+// Bilinearly resamples the side x side window centred on corner into lane of an interleaved group
+// Pixels outside the image replicate the border
+static void gatherWindow(const cv::Mat& gray, Point2f corner, int side, float* group, int lane) {
+	int half = side / 2;
+	int ix = cvFloor(corner.x), iy = cvFloor(corner.y);
+	float fx = corner.x - ix, fy = corner.y - iy;
+	float w00 = (1.0f - fx) * (1.0f - fy), w01 = fx * (1.0f - fy), w10 = (1.0f - fx) * fy, w11 = fx * fy;
+	int lastX = gray.cols - 1, lastY = gray.rows - 1;
+
+	for (int sy = 0; sy < side; sy++) {
+		int y = iy + sy - half;
+		const uchar* row0 = gray.ptr<uchar>(std::min(std::max(y, 0), lastY));
+		const uchar* row1 = gray.ptr<uchar>(std::min(std::max(y + 1, 0), lastY));
+		float* out = group + (size_t) sy * side * 4 + lane;
+		int x = ix - half;
+		if (x >= 0 && x + side < gray.cols) {
+			for (int sx = 0; sx < side; sx++, x++) out[sx * 4] = w00 * row0[x] + w01 * row0[x + 1] + w10 * row1[x] + w11 * row1[x + 1];
+		}
+		else {
+			for (int sx = 0; sx < side; sx++, x++) {
+				int x0 = std::min(std::max(x, 0), lastX), x1 = std::min(std::max(x + 1, 0), lastX);
+				out[sx * 4] = w00 * row0[x0] + w01 * row0[x1] + w10 * row1[x0] + w11 * row1[x1];
+			}
+		}
+	}
+}
+
+// Sums of the gradient products over the inner (side - 2)^2 samples of a group, weighted by mask:
+// sums[0..4] receive gxx, gxy, gyy and the two right-hand sides, each with one value per lane
+static void accumulateGroup(const float* group, int side, const float* mask, const float* offsets, float sums[5][4]) {
+	int inner = side - 2;
+#if CV_SIMD128
+	v_float32x4 a = v_setzero_f32(), b = v_setzero_f32(), c = v_setzero_f32(), bb1 = v_setzero_f32(), bb2 = v_setzero_f32();
+	for (int y = 1; y <= inner; y++) {
+		const float* row = group + (size_t) y * side * 4;
+		v_float32x4 py = v_setall_f32(offsets[y - 1]);
+		for (int x = 1; x <= inner; x++) {
+			v_float32x4 gx = v_load(row + (x + 1) * 4) - v_load(row + (x - 1) * 4);
+			v_float32x4 gy = v_load(row + (x + side) * 4) - v_load(row + (x - side) * 4);
+			v_float32x4 m = v_setall_f32(mask[(y - 1) * inner + x - 1]);
+			v_float32x4 px = v_setall_f32(offsets[x - 1]);
+			v_float32x4 gxx = gx * gx * m, gxy = gx * gy * m, gyy = gy * gy * m;
+			a += gxx;
+			b += gxy;
+			c += gyy;
+			bb1 += gxx * px + gxy * py;
+			bb2 += gxy * px + gyy * py;
+		}
+	}
+	v_store(sums[0], a);
+	v_store(sums[1], b);
+	v_store(sums[2], c);
+	v_store(sums[3], bb1);
+	v_store(sums[4], bb2);
+#else
+	for (int k = 0; k < 5; k++) std::fill(sums[k], sums[k] + 4, 0.0f);
+	for (int y = 1; y <= inner; y++) {
+		const float* row = group + (size_t) y * side * 4;
+		float py = offsets[y - 1];
+		for (int x = 1; x <= inner; x++) {
+			float m = mask[(y - 1) * inner + x - 1], px = offsets[x - 1];
+			for (int lane = 0; lane < 4; lane++) {
+				float gx = row[(x + 1) * 4 + lane] - row[(x - 1) * 4 + lane];
+				float gy = row[(x + side) * 4 + lane] - row[(x - side) * 4 + lane];
+				float gxx = gx * gx * m, gxy = gx * gy * m, gyy = gy * gy * m;
+				sums[0][lane] += gxx;
+				sums[1][lane] += gxy;
+				sums[2][lane] += gyy;
+				sums[3][lane] += gxx * px + gxy * py;
+				sums[4][lane] += gxy * px + gyy * py;
+			}
+		}
+	}
+#endif
+}
+
+// Refines all corners of one view; gray is 8-bit single channel
+static void refineView(const cv::Mat& gray, std::vector<Point2f>& corners, const RefinementOptions& options) {
+	if (corners.empty()) return;
+	int halfWindow = options.halfWindow > 0 ? options.halfWindow : windowForSpacing(corners);
+	if (backends.refinement == REFINE_CORNERSUBPIX) {
+		cornerSubPix(gray, corners, Size(halfWindow, halfWindow), Size(-1, -1), TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, options.maxIterations, options.epsilon));
+		return;
+	}
+	int inner = 2 * halfWindow + 1, side = inner + 2; // one extra sample on every side for the central differences
+	size_t groupSize = (size_t) side * side * 4;
+
+	// Gaussian weights that favour the gradients near the centre of the window
+	std::vector<float> mask((size_t) inner * inner), offsets(inner);
+	for (int i = 0; i < inner; i++) offsets[i] = (float) (i - halfWindow);
+	for (int y = 0; y < inner; y++) {
+		for (int x = 0; x < inner; x++) {
+			float u = offsets[x] / halfWindow, v = offsets[y] / halfWindow;
+			mask[(size_t) y * inner + x] = std::exp(-(u * u + v * v));
+		}
+	}
+
+	const std::vector<Point2f> initial = corners;
+	std::vector<size_t> active(corners.size());
+	for (size_t i = 0; i < active.size(); i++) active[i] = i;
+	std::vector<float> windows(((corners.size() + 3) / 4) * groupSize);
+	float epsilon2 = options.epsilon * options.epsilon;
+
+	for (int iteration = 0; iteration < options.maxIterations && !active.empty(); iteration++) {
+		size_t groups = (active.size() + 3) / 4;
+		std::fill(windows.begin(), windows.begin() + groups * groupSize, 0.0f);
+		for (size_t k = 0; k < active.size(); k++) gatherWindow(gray, corners[active[k]], side, windows.data() + (k / 4) * groupSize, (int) (k % 4));
+
+		size_t stillActive = 0;
+		for (size_t g = 0; g < groups; g++) {
+			float sums[5][4];
+			accumulateGroup(windows.data() + g * groupSize, side, mask.data(), offsets.data(), sums);
+			for (int lane = 0; lane < 4 && g * 4 + lane < active.size(); lane++) {
+				size_t index = active[g * 4 + lane];
+				float a = sums[0][lane], b = sums[1][lane], c = sums[2][lane], bb1 = sums[3][lane], bb2 = sums[4][lane];
+				float det = a * c - b * b;
+				if (std::abs(det) <= FLT_EPSILON * FLT_EPSILON) continue; // flat window, nothing to refine
+				Point2f shift((c * bb1 - b * bb2) / det, (a * bb2 - b * bb1) / det);
+				corners[index] += shift;
+				if (shift.dot(shift) > epsilon2) active[stillActive++] = index;
+			}
+		}
+		active.resize(stillActive);
+	}
+
+	// A corner that wandered out of its window locked onto something else; keep where the detector put it
+	for (size_t i = 0; i < corners.size(); i++) {
+		if (std::abs(corners[i].x - initial[i].x) > halfWindow || std::abs(corners[i].y - initial[i].y) > halfWindow) corners[i] = initial[i];
+	}
+}
+
+// Refines the corners of one image to sub-pixel accuracy; image may be color or grayscale
+void refineCorners(const cv::Mat& image, std::vector<Point2f>& corners, const RefinementOptions& options) {
+	TRACE_SCOPE("refineCorners");
+	if (image.channels() == 1) {
+		refineView(image, corners, options);
+		return;
+	}
+	Mat gray;
+	cvtColor(image, gray, COLOR_BGR2GRAY);
+	refineView(gray, corners, options);
+}
+
+// Refines the corners of many views in one pass, a view per task on workerCount threads
+// corners[v] lies in images[(*viewImages)[v]], or in images[v] without viewImages (the foundIndices of the detectors)
+void refineCornersBatch(Span<cv::Mat> images, std::vector<std::vector<Point2f>>& corners, const std::vector<size_t>* viewImages, const RefinementOptions& options, unsigned workerCount) {
+	TRACE_SCOPE("refineCornersBatch");
+	parallelFor(corners.size(), workerCount, [&](size_t view) {
+		refineCorners(images[viewImages ? (*viewImages)[view] : view], corners[view], options);
+	});
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Settings of the sub-pixel corner refinement
+// Each iteration moves a corner to the point that is most orthogonal to the image gradients around it, like
+// cv::cornerSubPix, whose criteria these mirror
+struct RefinementOptions
+{
+	int halfWindow = 0;      // half size of the search window; 0 derives it from the corner spacing of each view
+	int maxIterations = 20;
+	float epsilon = 0.01f;   // a corner is done once an iteration moves it less than this many pixels
+};
+
+int windowForSpacing(const std::vector<cv::Point2f>& corners, int maxHalfWindow = 11);
+void refineCorners(const cv::Mat& image, std::vector<cv::Point2f>& corners, const RefinementOptions& options = RefinementOptions());
+void refineCornersBatch(Span<cv::Mat> images, std::vector<std::vector<cv::Point2f>>& corners, const std::vector<size_t>* viewImages = nullptr, const RefinementOptions& options = RefinementOptions(), unsigned workerCount = 0);
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// The joint solve refines the pose of every camera relative to camera 0 together with the pose of the board in every
+// sample, holding the intrinsics of each camera fixed. A board couples only with the cameras that see it, so its
+// 6 x 6 block is eliminated with the Schur complement like the views of the sparse calibration solver; what is left
+// is a dense system over the 6 (C - 1) camera parameters, sized by the camera count and not by the number of samples
+
+// Normal equation blocks of one sample: the board block (V) and its gradient, and for every camera that saw the
+// board its own block (U), its coupling with the board (W) and its gradient
+struct SampleBlocks
+{
+	Matx66d V;
+	Vec6d gradientBoard;
+	std::vector<Matx66d> U, W;
+	std::vector<Vec6d> gradientCamera;
+	double cost;
+};
+
+// One image of a sample on its way to a detector
+struct RigImage
+{
+	size_t camera, sample;
+	cv::Mat gray;
+};
+
+static Matx33d skew(const Vec3d& v) {
+	return Matx33d(0.0, -v[2], v[1], v[2], 0.0, -v[0], -v[1], v[0], 0.0);
+}
+
+// In-place Cholesky factorisation of the dense n x n matrix A (row major) into its lower triangle
+static bool choleskyFactorDense(std::vector<double>& A, int n) {
+	for (int j = 0; j < n; j++) {
+		double diagonal = A[j * n + j];
+		for (int k = 0; k < j; k++) diagonal -= A[j * n + k] * A[j * n + k];
+		if (diagonal <= 0.0) return false;
+		A[j * n + j] = sqrt(diagonal);
+		for (int i = j + 1; i < n; i++) {
+			double sum = A[i * n + j];
+			for (int k = 0; k < j; k++) sum -= A[i * n + k] * A[j * n + k];
+			A[i * n + j] = sum / A[j * n + j];
+		}
+	}
+	return true;
+}
+
+// Solves L * L^T * x = b in place with the factor from choleskyFactorDense
+static void choleskySolveDense(const std::vector<double>& L, int n, std::vector<double>& b) {
+	for (int i = 0; i < n; i++) {
+		for (int k = 0; k < i; k++) b[i] -= L[i * n + k] * b[k];
+		b[i] /= L[i * n + i];
+	}
+	for (int i = n - 1; i >= 0; i--) {
+		for (int k = i + 1; k < n; k++) b[i] -= L[k * n + i] * b[k];
+		b[i] /= L[i * n + i];
+	}
+}
+
+// Projects the board of one sample into every camera that saw it and returns the squared error
+// With blocks, also accumulates the normal equations of the sample; rotations are linearised as small rotations
+// applied after R on both the camera and the board side
+static double evaluateSample(size_t sample, const std::vector<size_t>& cameras, const std::vector<std::vector<std::vector<Point2f>>>& observations, const std::vector<Point3f>& boardPoints, const std::vector<SharedIntrinsics>& intrinsics,
+	const std::vector<Matx33d>& cameraRotations, const std::vector<Vec3d>& cameraTranslations, const Matx33d& boardRotation, const Vec3d& boardTranslation, SampleBlocks* blocks) {
+	if (blocks) {
+		blocks->V = Matx66d();
+		blocks->gradientBoard = Vec6d();
+		blocks->U.assign(cameras.size(), Matx66d());
+		blocks->W.assign(cameras.size(), Matx66d());
+		blocks->gradientCamera.assign(cameras.size(), Vec6d());
+	}
+
+	double cost = 0.0;
+	for (size_t k = 0; k < cameras.size(); k++) {
+		size_t camera = cameras[k];
+		const Matx33d& Rc = cameraRotations[camera];
+		const std::vector<Point2f>& observed = observations[camera][sample];
+		for (size_t i = 0; i < boardPoints.size(); i++) {
+			Vec3d Xb = boardRotation * Vec3d(boardPoints[i].x, boardPoints[i].y, boardPoints[i].z);
+			Vec3d Yc = Rc * (Xb + boardTranslation);
+			Matx23d dPoint;
+			Vec2d residual = projectDistorted(intrinsics[camera], Yc + cameraTranslations[camera], blocks ? &dPoint : nullptr) - Vec2d(observed[i].x, observed[i].y);
+			cost += residual.dot(residual);
+			if (!blocks) continue;
+
+			Matx23d dBoard = dPoint * Rc;
+			Matx23d dBoardRotation = dBoard * -skew(Xb);
+			Matx<double, 2, 6> Jb(
+				dBoardRotation(0, 0), dBoardRotation(0, 1), dBoardRotation(0, 2), dBoard(0, 0), dBoard(0, 1), dBoard(0, 2),
+				dBoardRotation(1, 0), dBoardRotation(1, 1), dBoardRotation(1, 2), dBoard(1, 0), dBoard(1, 1), dBoard(1, 2)
+			);
+			blocks->V += Jb.t() * Jb;
+			blocks->gradientBoard += Jb.t() * residual;
+			if (camera == 0) continue; // the reference camera does not move
+
+			Matx23d dCameraRotation = dPoint * -skew(Yc);
+			Matx<double, 2, 6> Jc(
+				dCameraRotation(0, 0), dCameraRotation(0, 1), dCameraRotation(0, 2), dPoint(0, 0), dPoint(0, 1), dPoint(0, 2),
+				dCameraRotation(1, 0), dCameraRotation(1, 1), dCameraRotation(1, 2), dPoint(1, 0), dPoint(1, 1), dPoint(1, 2)
+			);
+			blocks->U[k] += Jc.t() * Jc;
+			blocks->W[k] += Jc.t() * Jb;
+			blocks->gradientCamera[k] += Jc.t() * residual;
+		}
+	}
+	if (blocks) blocks->cost = cost;
+	return cost;
+}
+
+// Minimises the reprojection error of all observations over the camera poses (camera 0 stays at the origin) and the
+// board pose of every sample; observations[camera][sample] is empty where that camera did not see the board
+// The poses hold the starting point and receive the solution; returns the RMS error
+// Samples are linearised and eliminated in parallel on workerCount threads, the reduction stays serial
+double refineRigExtrinsics(const std::vector<std::vector<std::vector<Point2f>>>& observations, const std::vector<Point3f>& boardPoints, const std::vector<SharedIntrinsics>& intrinsics, std::vector<Matx33d>& cameraRotations, std::vector<Vec3d>& cameraTranslations, std::vector<Matx33d>& boardRotations, std::vector<Vec3d>& boardTranslations, int maxIterations, unsigned workerCount) {
+	TRACE_SCOPE("refineRigExtrinsics");
+	size_t cameraCount = observations.size(), sampleCount = boardRotations.size();
+	int n = 6 * (int) (cameraCount - 1);
+
+	std::vector<std::vector<size_t>> sampleCameras(sampleCount);
+	size_t pointCount = 0;
+	for (size_t s = 0; s < sampleCount; s++) {
+		for (size_t c = 0; c < cameraCount; c++) {
+			if (!observations[c][s].empty()) sampleCameras[s].push_back(c);
+		}
+		pointCount += sampleCameras[s].size() * boardPoints.size();
+	}
+	if (pointCount == 0) return 0.0;
+
+	std::vector<SampleBlocks> blocks(sampleCount);
+	std::vector<Matx66d> factors(sampleCount);
+	std::vector<std::vector<Matx66d>> eliminated(sampleCount); // W * V^-1 of every camera of a sample
+	std::vector<char> sampleSolved(sampleCount);
+	std::vector<Matx33d> candidateCameraRotations(cameraCount), candidateBoardRotations(sampleCount);
+	std::vector<Vec3d> candidateCameraTranslations(cameraCount), candidateBoardTranslations(sampleCount);
+	std::vector<double> costs(sampleCount);
+
+	auto linearize = [&]() {
+		parallelFor(sampleCount, workerCount, [&](size_t s) {
+			evaluateSample(s, sampleCameras[s], observations, boardPoints, intrinsics, cameraRotations, cameraTranslations, boardRotations[s], boardTranslations[s], &blocks[s]);
+		});
+		double cost = 0.0;
+		for (const SampleBlocks& sample : blocks) cost += sample.cost;
+		return cost;
+	};
+
+	double cost = linearize();
+	double lambda = 1e-3;
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		bool improved = false;
+		double previousCost = cost;
+		while (!improved && lambda < 1e12) {
+			// Damped board blocks, factored, and their coupling with the cameras eliminated
+			parallelFor(sampleCount, workerCount, [&](size_t s) {
+				Matx66d V = blocks[s].V;
+				damp(V, lambda);
+				sampleSolved[s] = choleskyFactor(V);
+				if (!sampleSolved[s]) return;
+				factors[s] = V;
+				eliminated[s].resize(sampleCameras[s].size());
+				for (size_t k = 0; k < sampleCameras[s].size(); k++) {
+					if (sampleCameras[s][k] == 0) continue;
+					const Matx66d& W = blocks[s].W[k];
+					for (int i = 0; i < 6; i++) {
+						Vec6d row = choleskySolve(V, Vec6d(W(i, 0), W(i, 1), W(i, 2), W(i, 3), W(i, 4), W(i, 5)));
+						for (int j = 0; j < 6; j++) eliminated[s][k](i, j) = row[j];
+					}
+				}
+			});
+
+			// Schur complement: (U - sum W V^-1 W^T) dC = -gC + sum W V^-1 gB, over the cameras other than camera 0
+			std::vector<double> S((size_t) n * n, 0.0), rhs(n, 0.0), diagonal(n, 0.0);
+			bool solvable = true;
+			for (size_t s = 0; s < sampleCount && solvable; s++) {
+				solvable = sampleSolved[s] != 0;
+				const std::vector<size_t>& cameras = sampleCameras[s];
+				for (size_t a = 0; a < cameras.size(); a++) {
+					if (cameras[a] == 0) continue;
+					int offsetA = 6 * (int) (cameras[a] - 1);
+					Vec6d reduced = eliminated[s][a] * blocks[s].gradientBoard - blocks[s].gradientCamera[a];
+					for (int i = 0; i < 6; i++) {
+						rhs[offsetA + i] += reduced[i];
+						diagonal[offsetA + i] += blocks[s].U[a](i, i);
+					}
+					for (size_t b = 0; b < cameras.size(); b++) {
+						if (cameras[b] == 0) continue;
+						int offsetB = 6 * (int) (cameras[b] - 1);
+						Matx66d block = eliminated[s][a] * blocks[s].W[b].t() * -1.0;
+						if (a == b) block += blocks[s].U[a];
+						for (int i = 0; i < 6; i++) {
+							for (int j = 0; j < 6; j++) S[(size_t) (offsetA + i) * n + offsetB + j] += block(i, j);
+						}
+					}
+				}
+			}
+			for (int i = 0; i < n; i++) S[(size_t) i * n + i] += lambda * std::max(diagonal[i], DBL_EPSILON);
+			if (!solvable || !choleskyFactorDense(S, n)) {
+				lambda *= 10.0;
+				continue;
+			}
+			std::vector<double> stepCameras = rhs;
+			choleskySolveDense(S, n, stepCameras);
+
+			for (size_t c = 0; c < cameraCount; c++) {
+				candidateCameraRotations[c] = cameraRotations[c];
+				candidateCameraTranslations[c] = cameraTranslations[c];
+				if (c == 0) continue;
+				const double* step = &stepCameras[6 * (c - 1)];
+				candidateCameraRotations[c] = rotationVectorToMatx(Vec3d(step[0], step[1], step[2])) * cameraRotations[c];
+				candidateCameraTranslations[c] = cameraTranslations[c] + Vec3d(step[3], step[4], step[5]);
+			}
+
+			// Back-substitution per sample: V dB = -gB - sum W^T dC
+			parallelFor(sampleCount, workerCount, [&](size_t s) {
+				Vec6d rhsBoard = -blocks[s].gradientBoard;
+				for (size_t k = 0; k < sampleCameras[s].size(); k++) {
+					size_t c = sampleCameras[s][k];
+					if (c == 0) continue;
+					const double* step = &stepCameras[6 * (c - 1)];
+					rhsBoard -= blocks[s].W[k].t() * Vec6d(step[0], step[1], step[2], step[3], step[4], step[5]);
+				}
+				Vec6d step = choleskySolve(factors[s], rhsBoard);
+				candidateBoardRotations[s] = rotationVectorToMatx(Vec3d(step[0], step[1], step[2])) * boardRotations[s];
+				candidateBoardTranslations[s] = boardTranslations[s] + Vec3d(step[3], step[4], step[5]);
+				costs[s] = evaluateSample(s, sampleCameras[s], observations, boardPoints, intrinsics, candidateCameraRotations, candidateCameraTranslations, candidateBoardRotations[s], candidateBoardTranslations[s], nullptr);
+			});
+			double candidateCost = 0.0;
+			for (double c : costs) candidateCost += c;
+
+			if (candidateCost < cost) {
+				cameraRotations.swap(candidateCameraRotations);
+				cameraTranslations.swap(candidateCameraTranslations);
+				boardRotations.swap(candidateBoardRotations);
+				boardTranslations.swap(candidateBoardTranslations);
+				cost = linearize();
+				lambda = std::max(lambda * 0.1, 1e-12);
+				improved = true;
+			}
+			else {
+				lambda *= 10.0;
+			}
+		}
+		if (!improved || previousCost - cost <= DBL_EPSILON * previousCost) break;
+	}
+	return sqrt(cost / pointCount);
+}
+
+// Calibrates a rig from the corners of every camera; corners[camera][sample] is empty where the board was not found
+// Every camera is calibrated on its own first, one camera per task, which also gives the pose of the board in every
+// view. The camera poses start from a spanning tree grown from camera 0 along the pairs that share the most samples,
+// each edge the mean of the relative poses of the shared samples, and are then solved jointly by refineRigExtrinsics
+RigCalibrationResult calibrateRigFromCorners(const std::vector<std::vector<std::vector<Point2f>>>& corners, const std::vector<cv::Size>& imageSizes, cv::Size boardSize, float squareEdgeLength, const RigOptions& options) {
+	TRACE_SCOPE("calibrateRigFromCorners");
+	size_t cameraCount = corners.size(), sampleCount = cameraCount ? corners[0].size() : 0;
+	RigCalibrationResult result;
+	result.cameras.resize(cameraCount);
+	result.cameraPoses.resize(cameraCount);
+
+	// Intrinsics; the cameras run side by side, each solve on a single thread
+	parallelFor(cameraCount, options.workerCount, [&](size_t c) {
+		std::vector<std::vector<Point2f>> views;
+		std::vector<size_t> samples;
+		for (size_t s = 0; s < sampleCount; s++) {
+			if (corners[c][s].empty()) continue;
+			views.push_back(corners[c][s]);
+			samples.push_back(s);
+		}
+		if (views.size() < std::max<size_t>(options.minViews, 3)) return;
+		result.cameras[c] = calibrateFromCorners(views, imageSizes[c], boardSize, squareEdgeLength, nullptr, 30, 1);
+		for (size_t& index : result.cameras[c].viewIndices) index = samples[index];
+	});
+
+	// Board pose in every view of every camera
+	std::vector<std::vector<char>> seen(cameraCount, std::vector<char>(sampleCount, 0));
+	std::vector<std::vector<Matx33d>> viewRotations(cameraCount, std::vector<Matx33d>(sampleCount));
+	std::vector<std::vector<Vec3d>> viewTranslations(cameraCount, std::vector<Vec3d>(sampleCount));
+	for (size_t c = 0; c < cameraCount; c++) {
+		const CalibrationResult& camera = result.cameras[c];
+		for (size_t v = 0; v < camera.viewIndices.size(); v++) {
+			size_t s = camera.viewIndices[v];
+			seen[c][s] = 1;
+			viewRotations[c][s] = rotationVectorToMatx(Vec3d(camera.extrinsics[v].r));
+			viewTranslations[c][s] = Vec3d(camera.extrinsics[v].t);
+		}
+	}
+	if (cameraCount == 0 || result.cameras[0].intrinsics.K.empty()) {
+		printf("The reference camera could not be calibrated\n");
+		return result;
+	}
+
+	// Spanning tree of initial camera poses
+	std::vector<char> posed(cameraCount, 0);
+	std::vector<Matx33d> cameraRotations(cameraCount, Matx33d::eye());
+	std::vector<Vec3d> cameraTranslations(cameraCount);
+	posed[0] = 1;
+	while (true) {
+		size_t bestShared = 0, from = 0, to = 0;
+		for (size_t a = 0; a < cameraCount; a++) {
+			if (!posed[a]) continue;
+			for (size_t b = 0; b < cameraCount; b++) {
+				if (posed[b]) continue;
+				size_t shared = 0;
+				for (size_t s = 0; s < sampleCount; s++) shared += seen[a][s] && seen[b][s];
+				if (shared > bestShared) {
+					bestShared = shared;
+					from = a;
+					to = b;
+				}
+			}
+		}
+		if (bestShared == 0) break;
+
+		// Mean of the relative poses of the shared samples; the rotations are averaged as small corrections of the first
+		Matx33d first;
+		Vec3d rotationSum, translationSum;
+		bool haveFirst = false;
+		for (size_t s = 0; s < sampleCount; s++) {
+			if (!seen[from][s] || !seen[to][s]) continue;
+			Matx33d R = viewRotations[to][s] * viewRotations[from][s].t();
+			Vec3d t = viewTranslations[to][s] - R * viewTranslations[from][s];
+			if (!haveFirst) {
+				first = R;
+				haveFirst = true;
+			}
+			rotationSum += rotationMatxToVector(R * first.t());
+			translationSum += t;
+		}
+		Matx33d relativeRotation = rotationVectorToMatx(rotationSum * (1.0 / bestShared)) * first;
+		Vec3d relativeTranslation = translationSum * (1.0 / bestShared);
+		cameraRotations[to] = relativeRotation * cameraRotations[from];
+		cameraTranslations[to] = relativeRotation * cameraTranslations[from] + relativeTranslation;
+		posed[to] = 1;
+	}
+
+	// Samples seen by at least two posed cameras constrain the rig; their board pose starts from the first camera
+	std::vector<std::vector<std::vector<Point2f>>> observations(cameraCount);
+	std::vector<Matx33d> boardRotations;
+	std::vector<Vec3d> boardTranslations;
+	for (size_t s = 0; s < sampleCount; s++) {
+		std::vector<size_t> cameras;
+		for (size_t c = 0; c < cameraCount; c++) {
+			if (posed[c] && seen[c][s]) cameras.push_back(c);
+		}
+		if (cameras.size() < 2) continue;
+		size_t c = cameras[0];
+		boardRotations.push_back(cameraRotations[c].t() * viewRotations[c][s]);
+		boardTranslations.push_back(cameraRotations[c].t() * (viewTranslations[c][s] - cameraTranslations[c]));
+		for (size_t k = 0; k < cameraCount; k++) {
+			observations[k].push_back(posed[k] && seen[k][s] ? corners[k][s] : std::vector<Point2f>());
+		}
+	}
+
+	std::vector<SharedIntrinsics> intrinsics(cameraCount);
+	for (size_t c = 0; c < cameraCount; c++) {
+		if (posed[c]) intrinsics[c] = toSharedIntrinsics(result.cameras[c].intrinsics);
+	}
+	std::vector<Point3f> boardPoints;
+	createKnownBoardPosition(boardSize, squareEdgeLength, boardPoints);
+	result.projectionError = refineRigExtrinsics(observations, boardPoints, intrinsics, cameraRotations, cameraTranslations, boardRotations, boardTranslations, options.maxIterations, options.workerCount);
+
+	for (size_t c = 0; c < cameraCount; c++) {
+		if (!posed[c]) {
+			if (!result.cameras[c].intrinsics.K.empty()) printf("Camera %zu shares no sample with the rig\n", c);
+			continue;
+		}
+		result.cameraPoses[c].r = Mat(rotationMatxToVector(cameraRotations[c]));
+		result.cameraPoses[c].t = Mat(cameraTranslations[c]);
+	}
+	return result;
+}
+
+// Calibrates a rig from one synchronized source per camera, each anything openVideoSource accepts
+// Every camera has its own reader thread, so the streams decode in parallel; all of them feed one queue that
+// workerCount detector threads drain, which keeps the total time bound by the cores rather than by the camera count
+RigCalibrationResult cameraCalibrationRig(const std::vector<std::string>& sources, cv::Size boardSize, float squareEdgeLength, const RigOptions& options) {
+	size_t cameraCount = sources.size();
+	std::vector<VideoCapture> captures(cameraCount);
+	for (size_t c = 0; c < cameraCount; c++) {
+		if (!openVideoSource(captures[c], sources[c])) return RigCalibrationResult();
+	}
+	unsigned workerCount = options.workerCount ? options.workerCount : std::max(1u, std::thread::hardware_concurrency());
+
+	BoundedQueue<RigImage> queue(options.queueDepth);
+	std::vector<std::vector<std::vector<Point2f>>> corners(cameraCount, std::vector<std::vector<Point2f>>(options.maxSamples));
+	std::vector<size_t> samplesRead(cameraCount, 0);
+	std::vector<Size> imageSizes(cameraCount);
+	std::atomic<size_t> readersLeft(cameraCount);
+
+	// Read stage, one thread per camera; the last reader to finish closes the queue
+	auto reader = [&](size_t camera) {
+		Mat frame;
+		for (int frameIndex = 0; samplesRead[camera] < options.maxSamples && captures[camera].read(frame); frameIndex++) {
+			if (frameIndex % std::max(1, options.frameStride) != 0) continue;
+			TRACE_SCOPE("read");
+			Mat gray;
+			if (frame.channels() == 1) gray = frame.clone();
+			else cvtColor(frame, gray, COLOR_BGR2GRAY);
+			imageSizes[camera] = gray.size();
+			if (!queue.push(RigImage{ camera, samplesRead[camera]++, gray })) break;
+		}
+		if (--readersLeft == 0) queue.close();
+	};
+
+	// Detection stage; a board that is not found leaves its corners empty
+	auto detector = [&]() {
+		RigImage image;
+		while (queue.pop(image)) {
+			TRACE_SCOPE("detect");
+			std::vector<Point2f>& found = corners[image.camera][image.sample];
+			if (!detectChessboard(image.gray, 1.0, boardSize, found, options.detection)) found.clear();
+			image.gray.release();
+		}
+	};
+	std::vector<std::thread> threads;
+	for (size_t c = 0; c < cameraCount; c++) threads.emplace_back(reader, c);
+	for (unsigned w = 0; w < workerCount; w++) threads.emplace_back(detector);
+	for (std::thread& t : threads) t.join();
+
+	// The streams are synchronized, so a sample only exists where every camera got that far
+	size_t sampleCount = cameraCount ? *std::min_element(samplesRead.begin(), samplesRead.end()) : 0;
+	for (size_t c = 0; c < cameraCount; c++) {
+		corners[c].resize(sampleCount);
+		size_t found = 0;
+		for (const std::vector<Point2f>& view : corners[c]) found += !view.empty();
+		printf("Camera %zu found the board in %zu of %zu samples\n", c, found, sampleCount);
+	}
+
+	RigCalibrationResult result = calibrateRigFromCorners(corners, imageSizes, boardSize, squareEdgeLength, options);
+	for (size_t s = 0; s < sampleCount; s++) result.sampleFrames.push_back(s * std::max(1, options.frameStride));
+	return result;
+}
\ No newline at end of file
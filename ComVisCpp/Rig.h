@@ -0,0 +1,27 @@
+#pragma once
+
+// Settings of the multi-camera rig calibration
+struct RigOptions
+{
+	int frameStride = 10;   // consider every n-th frame of the synchronized streams as a sample only
+	size_t maxSamples = 60; // stop reading after this many samples
+	size_t minViews = 4;    // a camera needs the board in this many samples to be calibrated
+	size_t queueDepth = 8;  // frames waiting for a detector at most, over all cameras
+	int maxIterations = 30; // iterations of the joint extrinsics solve
+	unsigned workerCount = 0;
+	DetectionOptions detection;
+};
+
+// Calibration of a rig: every camera on its own, then the pose of every camera relative to camera 0
+// A camera's calibration has a view per sample it saw the board in; its viewIndices are sample indices
+struct RigCalibrationResult
+{
+	std::vector<CalibrationResult> cameras;
+	std::vector<Extrinsics> cameraPoses; // x_camera = R x_0 + t; empty for a camera that shares no sample with the rig
+	std::vector<size_t> sampleFrames;    // frame each sample was taken from
+	double projectionError = 0.0;        // RMS over every observation of the joint solve
+};
+
+double refineRigExtrinsics(const std::vector<std::vector<std::vector<cv::Point2f>>>& observations, const std::vector<cv::Point3f>& boardPoints, const std::vector<SharedIntrinsics>& intrinsics, std::vector<cv::Matx33d>& cameraRotations, std::vector<cv::Vec3d>& cameraTranslations, std::vector<cv::Matx33d>& boardRotations, std::vector<cv::Vec3d>& boardTranslations, int maxIterations = 30, unsigned workerCount = 0);
+RigCalibrationResult calibrateRigFromCorners(const std::vector<std::vector<std::vector<cv::Point2f>>>& corners, const std::vector<cv::Size>& imageSizes, cv::Size boardSize, float squareEdgeLength, const RigOptions& options = RigOptions());
+RigCalibrationResult cameraCalibrationRig(const std::vector<std::string>& sources, cv::Size boardSize, float squareEdgeLength, const RigOptions& options = RigOptions());
\ No newline at end of file
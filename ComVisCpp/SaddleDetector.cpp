@@ -0,0 +1,303 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// A response maximum that passed the ring test
+struct SaddleCandidate
+{
+	Point2f position;
+	float response;
+};
+
+// Offsets of the 16 pixels on a circle of radius 3, in order around it
+static const int ringOffsets[16][2] = {
+	{ 0, -3 }, { 1, -3 }, { 2, -2 }, { 3, -1 }, { 3, 0 }, { 3, 1 }, { 2, 2 }, { 1, 3 },
+	{ 0, 3 }, { -1, 3 }, { -2, 2 }, { -3, 1 }, { -3, 0 }, { -3, -1 }, { -2, -2 }, { -1, -3 }
+};
+static const int ringRadius = 3;
+
+// One pass of the separable binomial filter [1 4 6 4 1] / 16 over a width x height float image; borders replicate
+// tmp holds the horizontal pass, src and dst may be the same buffer
+static void smoothBinomial(const float* src, float* tmp, float* dst, int width, int height) {
+	kernels.smoothRows(src, tmp, width, height);
+	kernels.smoothColumns(tmp, dst, width, height);
+}
+
+// An X-junction seen on a small circle alternates dark, bright, dark, bright; edges and L-corners of the board border
+// change only twice, noise rarely shows enough contrast
+static bool passesRingTest(const float* image, int width, int x, int y, float minContrast) {
+	float samples[16], sum = 0.0f, low = FLT_MAX, high = -FLT_MAX;
+	for (int i = 0; i < 16; i++) {
+		samples[i] = image[(size_t) (y + ringOffsets[i][1]) * width + x + ringOffsets[i][0]];
+		sum += samples[i];
+		low = std::min(low, samples[i]);
+		high = std::max(high, samples[i]);
+	}
+	if (high - low < minContrast) return false;
+
+	float mean = sum / 16.0f;
+	int changes = 0;
+	for (int i = 0; i < 16; i++) {
+		if ((samples[i] > mean) != (samples[(i + 1) % 16] > mean)) changes++;
+	}
+	return changes == 4;
+}
+
+// Non-maximum suppression, ring test and a parabola fit through the response for sub-pixel positions
+static void collectCandidates(const float* image, const float* response, int width, int height, float threshold, const SaddleOptions& options, std::vector<SaddleCandidate>& candidates) {
+	int border = std::max(options.suppressionRadius, ringRadius);
+	for (int y = border; y < height - border; y++) {
+		const float* r = response + (size_t) y * width;
+		for (int x = border; x < width - border; x++) {
+			float value = r[x];
+			if (value < threshold) continue;
+
+			// Ties go to the first pixel in scan order
+			bool isMaximum = true;
+			for (int dy = -options.suppressionRadius; dy <= options.suppressionRadius && isMaximum; dy++) {
+				const float* other = r + (ptrdiff_t) dy * width;
+				for (int dx = -options.suppressionRadius; dx <= options.suppressionRadius; dx++) {
+					bool before = dy < 0 || (dy == 0 && dx < 0);
+					if (other[x + dx] > value || (before && other[x + dx] == value)) {
+						isMaximum = false;
+						break;
+					}
+				}
+			}
+			if (!isMaximum || !passesRingTest(image, width, x, y, options.minContrast)) continue;
+
+			float left = r[x - 1], right = r[x + 1], up = r[x - width], down = r[x + width];
+			float curvatureX = left + right - 2.0f * value, curvatureY = up + down - 2.0f * value;
+			float offsetX = curvatureX < 0.0f ? 0.5f * (left - right) / curvatureX : 0.0f;
+			float offsetY = curvatureY < 0.0f ? 0.5f * (up - down) / curvatureY : 0.0f;
+			candidates.push_back({ Point2f(x + offsetX, y + offsetY), value });
+		}
+	}
+}
+
+// Index of the closest unused point within radius of at, or -1
+static int nearestUnused(const std::vector<Point2f>& points, const std::vector<bool>& used, Point2f at, float radius) {
+	int best = -1;
+	float bestDistance = radius * radius;
+	for (size_t i = 0; i < points.size(); i++) {
+		if (used[i]) continue;
+		Point2f d = points[i] - at;
+		float distance = d.dot(d);
+		if (distance < bestDistance) {
+			bestDistance = distance;
+			best = (int) i;
+		}
+	}
+	return best;
+}
+
+// Grows a grid of corners outward from points[seed]
+// The seed, its nearest neighbour and the nearest point roughly perpendicular to that span the first cell; every
+// further corner is predicted from the cells already placed (continuing a row, or completing a parallelogram, so that
+// perspective is followed) and taken when a point lies close enough to the prediction
+// Succeeds when exactly one fully occupied boardSize window exists in the grown grid; corners receive it row by row
+static bool assembleGrid(const std::vector<Point2f>& points, size_t seed, cv::Size boardSize, std::vector<Point2f>& corners) {
+	std::vector<bool> used(points.size(), false);
+	used[seed] = true;
+	Point2f origin = points[seed];
+
+	int first = nearestUnused(points, used, origin, FLT_MAX);
+	if (first < 0) return false;
+	Point2f axisI = points[first] - origin;
+	float spacing = (float) norm(axisI);
+
+	int second = -1;
+	float secondDistance = FLT_MAX;
+	for (size_t i = 0; i < points.size(); i++) {
+		if (used[i] || (int) i == first) continue;
+		Point2f d = points[i] - origin;
+		float length = (float) norm(d);
+		if (length < 0.5f * spacing || length > 2.0f * spacing) continue;
+		if (std::abs(d.dot(axisI)) > 0.5f * length * spacing) continue;
+		if (length < secondDistance) {
+			secondDistance = length;
+			second = (int) i;
+		}
+	}
+	if (second < 0) return false;
+	Point2f axisJ = points[second] - origin;
+
+	std::map<std::pair<int, int>, int> cells;
+	auto at = [&](int i, int j) {
+		auto cell = cells.find(std::make_pair(i, j));
+		return cell == cells.end() ? -1 : cell->second;
+	};
+	cells[std::make_pair(0, 0)] = (int) seed;
+	cells[std::make_pair(1, 0)] = first;
+	cells[std::make_pair(0, 1)] = second;
+	used[first] = used[second] = true;
+
+	const size_t maxCells = (size_t) boardSize.area() * 4;
+	static const int directions[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	std::deque<std::pair<int, int>> open = { std::make_pair(0, 0), std::make_pair(1, 0), std::make_pair(0, 1) };
+	while (!open.empty() && cells.size() < maxCells) {
+		int i = open.front().first, j = open.front().second;
+		open.pop_front();
+		Point2f position = points[at(i, j)];
+
+		for (const int* direction : directions) {
+			int di = direction[0], dj = direction[1];
+			if (at(i + di, j + dj) >= 0) continue;
+
+			Point2f step = di != 0 ? axisI * (float) di : axisJ * (float) dj;
+			int behind = at(i - di, j - dj);
+			if (behind >= 0) {
+				step = position - points[behind];
+			}
+			else {
+				for (int side = -1; side <= 1; side += 2) {
+					int besideFrom = at(i + side * dj, j + side * di);
+					int besideTo = at(i + side * dj + di, j + side * di + dj);
+					if (besideFrom >= 0 && besideTo >= 0) {
+						step = points[besideTo] - points[besideFrom];
+						break;
+					}
+				}
+			}
+
+			int found = nearestUnused(points, used, position + step, 0.35f * (float) norm(step));
+			if (found < 0) continue;
+			cells[std::make_pair(i + di, j + dj)] = found;
+			used[found] = true;
+			open.push_back(std::make_pair(i + di, j + dj));
+		}
+	}
+	if (cells.size() < (size_t) boardSize.area()) return false;
+
+	int minI = INT_MAX, maxI = INT_MIN, minJ = INT_MAX, maxJ = INT_MIN;
+	for (const auto& cell : cells) {
+		minI = std::min(minI, cell.first.first);
+		maxI = std::max(maxI, cell.first.first);
+		minJ = std::min(minJ, cell.first.second);
+		maxJ = std::max(maxJ, cell.first.second);
+	}
+
+	// Stray points next to the board may extend the grid, so look for the one window the board fills completely
+	// The board rows run along i in the first layout and along j in the second
+	int w = boardSize.width, h = boardSize.height;
+	int matches = 0, windowI = 0, windowJ = 0;
+	bool transposed = false;
+	for (int layout = 0; layout < (w == h ? 1 : 2); layout++) {
+		int spanI = layout == 0 ? w : h, spanJ = layout == 0 ? h : w;
+		for (int i0 = minI; i0 + spanI - 1 <= maxI; i0++) {
+			for (int j0 = minJ; j0 + spanJ - 1 <= maxJ; j0++) {
+				bool full = true;
+				for (int i = 0; i < spanI && full; i++) {
+					for (int j = 0; j < spanJ && full; j++) full = at(i0 + i, j0 + j) >= 0;
+				}
+				if (!full) continue;
+				matches++;
+				windowI = i0;
+				windowJ = j0;
+				transposed = layout == 1;
+			}
+		}
+	}
+	if (matches != 1) return false;
+
+	corners.resize((size_t) w * h);
+	for (int row = 0; row < h; row++) {
+		for (int column = 0; column < w; column++) {
+			int index = transposed ? at(windowI + row, windowJ + column) : at(windowI + column, windowJ + row);
+			corners[(size_t) row * w + column] = points[index];
+		}
+	}
+	return true;
+}
+
+// Gray level of the outer square diagonally behind corner, half a step back along both board directions
+static uchar outerSquareLevel(const cv::Mat& gray, Point2f corner, Point2f alongRow, Point2f alongColumn) {
+	Point2f center = corner - (alongRow + alongColumn) * 0.5f;
+	int x = std::min(std::max(cvRound(center.x), 0), gray.cols - 1);
+	int y = std::min(std::max(cvRound(center.y), 0), gray.rows - 1);
+	return gray.at<uchar>(y, x);
+}
+
+// Puts the corners in the order of findChessboardCorners: rows run clockwise to columns in the image (like x to y),
+// and when exactly one side has an odd number of corners, like 9 x 6, the first corner is the one whose outer square
+// is black; the square at the opposite corner is white, which tells a half turn of the board apart
+// Other boards look the same after a half turn and OpenCV's choice depends on the image; there the first corner is
+// the one nearest the image origin among the orders that keep the handedness
+static void canonicalOrder(const cv::Mat& gray, std::vector<Point2f>& corners, cv::Size boardSize) {
+	int w = boardSize.width, h = boardSize.height;
+	if ((corners[1] - corners[0]).cross(corners[w] - corners[0]) < 0) {
+		for (int row = 0; row < h; row++) std::reverse(corners.begin() + (size_t) row * w, corners.begin() + (size_t) (row + 1) * w);
+	}
+
+	if (w % 2 != h % 2) {
+		size_t last = corners.size() - 1;
+		uchar first = outerSquareLevel(gray, corners[0], corners[1] - corners[0], corners[w] - corners[0]);
+		uchar opposite = outerSquareLevel(gray, corners[last], corners[last - 1] - corners[last], corners[last - w] - corners[last]);
+		if (first > opposite) std::reverse(corners.begin(), corners.end());
+		return;
+	}
+
+	std::vector<Point2f> best = corners, candidate = corners;
+	int turns = w == h ? 4 : 2;
+	for (int turn = 1; turn < turns; turn++) {
+		if (w == h) {
+			// Quarter turn of the labels
+			std::vector<Point2f> previous = candidate;
+			for (int row = 0; row < h; row++) {
+				for (int column = 0; column < w; column++) candidate[(size_t) row * w + column] = previous[(size_t) (w - 1 - column) * w + row];
+			}
+		}
+		else {
+			std::reverse(candidate.begin(), candidate.end());
+		}
+		if (candidate[0].x + candidate[0].y < best[0].x + best[0].y) best = candidate;
+	}
+	corners = best;
+}
+
+// Finds the inner corners of a chess board with a saddle-point filter instead of cv::findChessboardCorners
+// gray has to be 8-bit single channel; corners receive boardSize.area() points in the order of findChessboardCorners
+// (on boards that look the same after a half turn the first corner may differ, see canonicalOrder)
+bool findChessboardSaddles(const cv::Mat& gray, cv::Size boardSize, std::vector<Point2f>& corners, const SaddleOptions& options) {
+	TRACE_SCOPE("findChessboardSaddles");
+	CV_Assert(gray.type() == CV_8UC1);
+	corners.clear();
+	int width = gray.cols, height = gray.rows;
+	int border = std::max(options.suppressionRadius, ringRadius);
+	if (boardSize.width < 2 || boardSize.height < 2 || width <= 2 * border || height <= 2 * border) return false;
+
+	size_t pixels = (size_t) width * height;
+	std::vector<float> image(pixels), scratch(pixels), response(pixels);
+	for (int y = 0; y < height; y++) {
+		const uchar* source = gray.ptr<uchar>(y);
+		float* target = image.data() + (size_t) y * width;
+		for (int x = 0; x < width; x++) target[x] = source[x];
+	}
+	for (int pass = 0; pass < options.smoothing; pass++) smoothBinomial(image.data(), scratch.data(), image.data(), width, height);
+
+	float strongest = kernels.saddleResponse(image.data(), response.data(), width, height);
+	if (strongest <= 0.0f) return false;
+
+	std::vector<SaddleCandidate> candidates;
+	collectCandidates(image.data(), response.data(), width, height, options.threshold * strongest, options, candidates);
+	if (candidates.size() < (size_t) boardSize.area()) return false;
+
+	// Strongest first; these also serve as the seeds of the grid assembly
+	std::sort(candidates.begin(), candidates.end(), [](const SaddleCandidate& a, const SaddleCandidate& b) { return a.response > b.response; });
+	size_t keep = options.maxCandidates ? options.maxCandidates : (size_t) boardSize.area() * 8;
+	if (candidates.size() > keep) candidates.resize(keep);
+	std::vector<Point2f> points;
+	points.reserve(candidates.size());
+	for (const SaddleCandidate& candidate : candidates) points.push_back(candidate.position);
+
+	const size_t maxSeeds = 16;
+	for (size_t seed = 0; seed < std::min(maxSeeds, points.size()); seed++) {
+		if (assembleGrid(points, seed, boardSize, corners)) {
+			canonicalOrder(gray, corners, boardSize);
+			return true;
+		}
+	}
+	corners.clear();
+	return false;
+}
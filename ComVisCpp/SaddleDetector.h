@@ -0,0 +1,15 @@
+#pragma once
+
+// Settings of the saddle-point corner detector
+// Inner chessboard corners are X-junctions, where the image forms a saddle: the determinant of the Hessian is strongly
+// negative there and close to zero along edges, so the response Ixy^2 - Ixx * Iyy singles them out
+struct SaddleOptions
+{
+	int smoothing = 1;         // passes of the binomial filter [1 4 6 4 1] / 16 before the response (sigma 1 each)
+	float threshold = 0.1f;    // weakest accepted response, relative to the strongest one in the image
+	int suppressionRadius = 3; // a candidate has to be the strongest response within this many pixels
+	float minContrast = 20.0f; // gray levels between the darkest and brightest sample on the ring around a candidate
+	size_t maxCandidates = 0;  // strongest candidates kept for the grid assembly; 0 keeps 8 per board corner
+};
+
+bool findChessboardSaddles(const cv::Mat& gray, cv::Size boardSize, std::vector<cv::Point2f>& corners, const SaddleOptions& options = SaddleOptions());
\ No newline at end of file
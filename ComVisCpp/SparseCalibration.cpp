@@ -0,0 +1,261 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Levenberg-Marquardt over all views at once. The normal equations have block-arrow structure: a 9 x 9 block for the
+// shared intrinsics, a 6 x 6 block per view and the 9 x 6 coupling of each view with the intrinsics, but nothing
+// between two views. Eliminating the view blocks with the Schur complement leaves a 9 x 9 system, so an iteration
+// costs time linear in the number of views, where the dense normal equations of calibrateCamera grow with their cube
+
+typedef Matx<double, 9, 9> Matx99d;
+typedef Matx<double, 9, 6> Matx96d;
+
+// Normal equation blocks of one view: J^T J split into intrinsics (U), extrinsics (V) and coupling (W), J^T r split
+// the same way, and the squared error
+struct ViewBlocks
+{
+	Matx99d U;
+	Matx66d V;
+	Matx96d W;
+	SharedIntrinsics gradientIntrinsics;
+	Vec6d gradientExtrinsics;
+	double cost;
+};
+
+// Parameters of a calibrated camera in the form the solvers use; distortion beyond k3 is dropped
+SharedIntrinsics toSharedIntrinsics(const Intrinsics& intrinsics) {
+	Matx33d K(intrinsics.K);
+	Mat D;
+	intrinsics.D.convertTo(D, CV_64F);
+	SharedIntrinsics p(K(0, 0), K(1, 1), K(0, 2), K(1, 2), 0.0, 0.0, 0.0, 0.0, 0.0);
+	for (int i = 0; i < 5 && i < (int) D.total(); i++) p[4 + i] = D.ptr<double>()[i];
+	return p;
+}
+
+// Pixel of the camera frame point Xc under the intrinsics p; with dPoint, also its derivative by Xc through the
+// perspective division and the lens distortion (the same chain evaluateView uses)
+cv::Vec2d projectDistorted(const SharedIntrinsics& p, const cv::Vec3d& Xc, cv::Matx23d* dPoint) {
+	const double fx = p[0], fy = p[1], cx = p[2], cy = p[3];
+	const double k1 = p[4], k2 = p[5], p1 = p[6], p2 = p[7], k3 = p[8];
+	double iz = 1.0 / Xc[2];
+	double x = Xc[0] * iz, y = Xc[1] * iz;
+	double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+	double radial = 1.0 + k1 * r2 + k2 * r4 + k3 * r6;
+	double xd = x * radial + 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x);
+	double yd = y * radial + p1 * (r2 + 2.0 * y * y) + 2.0 * p2 * x * y;
+	if (dPoint) {
+		double radialSlope = k1 + 2.0 * k2 * r2 + 3.0 * k3 * r4;
+		double dxdx = radial + 2.0 * x * x * radialSlope + 2.0 * p1 * y + 6.0 * p2 * x;
+		double dxdy = 2.0 * x * y * radialSlope + 2.0 * p1 * x + 2.0 * p2 * y;
+		double dydy = radial + 2.0 * y * y * radialSlope + 6.0 * p1 * y + 2.0 * p2 * x;
+		Matx22d distortion(fx * dxdx, fx * dxdy, fy * dxdy, fy * dydy);
+		*dPoint = distortion * Matx23d(iz, 0.0, -x * iz, 0.0, iz, -y * iz);
+	}
+	return Vec2d(fx * xd + cx, fy * yd + cy);
+}
+
+// Projects the board into one view and returns the squared error against the observed corners
+// With blocks, also accumulates the normal equations of the view. The rotation is linearised as a small rotation
+// applied after R, which keeps its Jacobian simple: d(R X) / d omega = -[R X]x
+static double evaluateView(const SharedIntrinsics& p, const Matx33d& R, const Vec3d& t, const std::vector<Point3f>& board, const std::vector<Point2f>& observed, ViewBlocks* blocks) {
+	const double fx = p[0], fy = p[1], cx = p[2], cy = p[3];
+	const double k1 = p[4], k2 = p[5], p1 = p[6], p2 = p[7], k3 = p[8];
+	if (blocks) *blocks = ViewBlocks();
+
+	double cost = 0.0;
+	for (size_t i = 0; i < board.size(); i++) {
+		Vec3d X = R * Vec3d(board[i].x, board[i].y, board[i].z);
+		Vec3d Xc = X + t;
+		double iz = 1.0 / Xc[2];
+		double x = Xc[0] * iz, y = Xc[1] * iz;
+
+		double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+		double radial = 1.0 + k1 * r2 + k2 * r4 + k3 * r6;
+		double xd = x * radial + 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x);
+		double yd = y * radial + p1 * (r2 + 2.0 * y * y) + 2.0 * p2 * x * y;
+		Vec2d residual(fx * xd + cx - observed[i].x, fy * yd + cy - observed[i].y);
+		cost += residual.dot(residual);
+		if (!blocks) continue;
+
+		const double intrinsicRows[18] = {
+			xd, 0.0, 1.0, 0.0, fx * x * r2, fx * x * r4, fx * 2.0 * x * y, fx * (r2 + 2.0 * x * x), fx * x * r6,
+			0.0, yd, 0.0, 1.0, fy * y * r2, fy * y * r4, fy * (r2 + 2.0 * y * y), fy * 2.0 * x * y, fy * y * r6
+		};
+		Matx<double, 2, 9> Ji(intrinsicRows);
+
+		// Chain rule from the pixel through the distortion and the perspective division to the camera frame point
+		double radialSlope = k1 + 2.0 * k2 * r2 + 3.0 * k3 * r4; // d radial / d r2
+		double dxdx = radial + 2.0 * x * x * radialSlope + 2.0 * p1 * y + 6.0 * p2 * x;
+		double dxdy = 2.0 * x * y * radialSlope + 2.0 * p1 * x + 2.0 * p2 * y;
+		double dydy = radial + 2.0 * y * y * radialSlope + 6.0 * p1 * y + 2.0 * p2 * x;
+		Matx22d distortion(fx * dxdx, fx * dxdy, fy * dxdy, fy * dydy);
+		Matx23d perspective(iz, 0.0, -x * iz, 0.0, iz, -y * iz);
+		Matx23d dPoint = distortion * perspective;
+		Matx33d skew(0.0, -X[2], X[1], X[2], 0.0, -X[0], -X[1], X[0], 0.0);
+		Matx23d dRotation = dPoint * -skew;
+		Matx<double, 2, 6> Je(
+			dRotation(0, 0), dRotation(0, 1), dRotation(0, 2), dPoint(0, 0), dPoint(0, 1), dPoint(0, 2),
+			dRotation(1, 0), dRotation(1, 1), dRotation(1, 2), dPoint(1, 0), dPoint(1, 1), dPoint(1, 2)
+		);
+
+		blocks->U += Ji.t() * Ji;
+		blocks->V += Je.t() * Je;
+		blocks->W += Ji.t() * Je;
+		blocks->gradientIntrinsics += Ji.t() * residual;
+		blocks->gradientExtrinsics += Je.t() * residual;
+	}
+	if (blocks) blocks->cost = cost;
+	return cost;
+}
+
+// Minimises the reprojection error of all views over the shared intrinsics and the pose of every view
+// intrinsics, rotations and translations hold the starting point and receive the solution; returns the RMS error
+// Views are linearised and eliminated in parallel on workerCount threads; the reduction over views stays serial,
+// so the result does not depend on the number of threads
+double refineCalibrationSparse(const std::vector<std::vector<Point2f>>& foundPoints, const std::vector<Point3f>& boardPoints, SharedIntrinsics& intrinsics, std::vector<Matx33d>& rotations, std::vector<Vec3d>& translations, int maxIterations, unsigned workerCount) {
+	TRACE_SCOPE("refineCalibrationSparse");
+	size_t viewCount = foundPoints.size();
+	size_t pointCount = viewCount * boardPoints.size();
+	if (pointCount == 0) return 0.0;
+
+	std::vector<ViewBlocks> blocks(viewCount);
+	std::vector<Matx66d> factors(viewCount);
+	std::vector<Matx96d> eliminated(viewCount); // W * V^-1 of every view
+	std::vector<char> viewSolved(viewCount);
+	std::vector<Matx33d> candidateRotations(viewCount);
+	std::vector<Vec3d> candidateTranslations(viewCount);
+	std::vector<double> costs(viewCount);
+
+	auto linearize = [&]() {
+		parallelFor(viewCount, workerCount, [&](size_t v) { evaluateView(intrinsics, rotations[v], translations[v], boardPoints, foundPoints[v], &blocks[v]); });
+		double cost = 0.0;
+		for (const ViewBlocks& view : blocks) cost += view.cost;
+		return cost;
+	};
+
+	double cost = linearize();
+	double lambda = 1e-3;
+	for (int iteration = 0; iteration < maxIterations; iteration++) {
+		bool improved = false;
+		double previousCost = cost;
+		while (!improved && lambda < 1e12) {
+			// Damped view blocks, factored, and their coupling with the intrinsics eliminated
+			parallelFor(viewCount, workerCount, [&](size_t v) {
+				Matx66d V = blocks[v].V;
+				damp(V, lambda);
+				viewSolved[v] = choleskyFactor(V);
+				if (!viewSolved[v]) return;
+				factors[v] = V;
+				const Matx96d& W = blocks[v].W;
+				for (int i = 0; i < 9; i++) {
+					Vec6d row = choleskySolve(V, Vec6d(W(i, 0), W(i, 1), W(i, 2), W(i, 3), W(i, 4), W(i, 5)));
+					for (int j = 0; j < 6; j++) eliminated[v](i, j) = row[j];
+				}
+			});
+
+			// Schur complement: (U - W V^-1 W^T) dI = -gI + W V^-1 gE
+			Matx99d S;
+			SharedIntrinsics rhs;
+			bool solvable = true;
+			for (size_t v = 0; v < viewCount && solvable; v++) {
+				solvable = viewSolved[v] != 0;
+				S += blocks[v].U - eliminated[v] * blocks[v].W.t();
+				rhs += eliminated[v] * blocks[v].gradientExtrinsics - blocks[v].gradientIntrinsics;
+			}
+			Matx99d U;
+			for (const ViewBlocks& view : blocks) U += view.U;
+			for (int i = 0; i < 9; i++) S(i, i) += lambda * std::max(U(i, i), DBL_EPSILON);
+			if (!solvable || !choleskyFactor(S)) {
+				lambda *= 10.0;
+				continue;
+			}
+			SharedIntrinsics stepIntrinsics = choleskySolve(S, rhs);
+			SharedIntrinsics candidate = intrinsics + stepIntrinsics;
+
+			// Back-substitution per view: V dE = -gE - W^T dI
+			parallelFor(viewCount, workerCount, [&](size_t v) {
+				Vec6d step = choleskySolve(factors[v], -(blocks[v].gradientExtrinsics + blocks[v].W.t() * stepIntrinsics));
+				candidateRotations[v] = rotationVectorToMatx(Vec3d(step[0], step[1], step[2])) * rotations[v];
+				candidateTranslations[v] = translations[v] + Vec3d(step[3], step[4], step[5]);
+				costs[v] = evaluateView(candidate, candidateRotations[v], candidateTranslations[v], boardPoints, foundPoints[v], nullptr);
+			});
+			double candidateCost = 0.0;
+			for (double c : costs) candidateCost += c;
+
+			if (candidateCost < cost) {
+				intrinsics = candidate;
+				rotations.swap(candidateRotations);
+				translations.swap(candidateTranslations);
+				cost = linearize();
+				lambda = std::max(lambda * 0.1, 1e-12);
+				improved = true;
+			}
+			else {
+				lambda *= 10.0;
+			}
+		}
+		if (!improved || previousCost - cost <= DBL_EPSILON * previousCost) break;
+	}
+	return sqrt(cost / pointCount);
+}
+
+// Calibrates with the sparse solver instead of calibrateCamera; same inputs and outputs as calibrateFromCorners
+// Without an initial guess the intrinsics start from initCameraMatrix2D, the poses from solvePnP, as calibrateCamera does
+// With initial poses, the first views start from those instead of solvePnP, which only runs for the views after them
+// The solver fits the five-coefficient distortion model; D comes out with eight entries, the last three zero
+CalibrationResult calibrateSparse(const std::vector<std::vector<Point2f>>& foundPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, const Intrinsics* initialGuess, int maxIterations, unsigned workerCount, const std::vector<Extrinsics>* initialPoses) {
+	TRACE_SCOPE("calibrateSparse");
+	std::vector<Point3f> boardPoints;
+	createKnownBoardPosition(boardSize, squareEdgeLength, boardPoints);
+	size_t viewCount = foundPoints.size();
+
+	Matx33d K;
+	Mat D = Mat::zeros(5, 1, CV_64F);
+	if (initialGuess) {
+		K = Matx33d(initialGuess->K);
+		Mat guessD;
+		initialGuess->D.convertTo(guessD, CV_64F);
+		for (int i = 0; i < 5 && i < (int) guessD.total(); i++) D.at<double>(i) = guessD.ptr<double>()[i];
+	}
+	else {
+		std::vector<std::vector<Point3f>> objectPoints(viewCount, boardPoints);
+		K = Matx33d(initCameraMatrix2D(objectPoints, foundPoints, imageSize, 0));
+	}
+
+	std::vector<Matx33d> rotations(viewCount);
+	std::vector<Vec3d> translations(viewCount);
+	parallelFor(viewCount, workerCount, [&](size_t v) {
+		if (initialPoses && v < initialPoses->size()) {
+			rotations[v] = rotationVectorToMatx(Vec3d((*initialPoses)[v].r));
+			translations[v] = Vec3d((*initialPoses)[v].t);
+			return;
+		}
+		Vec3d rvec, tvec;
+		solvePnP(boardPoints, foundPoints[v], K, D, rvec, tvec);
+		rotations[v] = rotationVectorToMatx(rvec);
+		translations[v] = tvec;
+	});
+
+	const double* d = D.ptr<double>();
+	SharedIntrinsics intrinsics(K(0, 0), K(1, 1), K(0, 2), K(1, 2), d[0], d[1], d[2], d[3], d[4]);
+
+	CalibrationResult result;
+	result.projectionError = refineCalibrationSparse(foundPoints, boardPoints, intrinsics, rotations, translations, maxIterations, workerCount);
+	printf("\nProjection error: %f\n", result.projectionError);
+
+	result.intrinsics.K = (Mat_<double>(3, 3) << intrinsics[0], 0.0, intrinsics[2], 0.0, intrinsics[1], intrinsics[3], 0.0, 0.0, 1.0);
+	result.intrinsics.D = Mat::zeros(8, 1, CV_64F);
+	for (int i = 0; i < 5; i++) result.intrinsics.D.at<double>(i) = intrinsics[4 + i];
+
+	result.extrinsics.resize(viewCount);
+	result.viewIndices.resize(viewCount);
+	for (size_t v = 0; v < viewCount; v++) {
+		result.extrinsics[v].r = Mat(rotationMatxToVector(rotations[v]));
+		result.extrinsics[v].t = Mat(translations[v]);
+		result.viewIndices[v] = v;
+	}
+
+	computeReprojectionErrors(result.intrinsics, result.extrinsics, foundPoints, boardPoints, result.viewErrors);
+	return result;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Parameters of the sparse solver: the intrinsics every view shares, fx, fy, cx, cy and the distortion
+// coefficients k1, k2, p1, p2, k3 (the model calibrateCamera fits without flags)
+typedef cv::Vec<double, 9> SharedIntrinsics;
+
+// In-place Cholesky factorisation A = L * L^T into the lower triangle; false when A is not positive definite
+template <int N>
+inline bool choleskyFactor(cv::Matx<double, N, N>& A) {
+	for (int j = 0; j < N; j++) {
+		double diagonal = A(j, j);
+		for (int k = 0; k < j; k++) diagonal -= A(j, k) * A(j, k);
+		if (diagonal <= 0.0) return false;
+		A(j, j) = sqrt(diagonal);
+		for (int i = j + 1; i < N; i++) {
+			double sum = A(i, j);
+			for (int k = 0; k < j; k++) sum -= A(i, k) * A(j, k);
+			A(i, j) = sum / A(j, j);
+		}
+	}
+	return true;
+}
+
+// Solves L * L^T * x = b with the factor from choleskyFactor
+template <int N>
+inline cv::Vec<double, N> choleskySolve(const cv::Matx<double, N, N>& L, cv::Vec<double, N> b) {
+	for (int i = 0; i < N; i++) {
+		for (int k = 0; k < i; k++) b[i] -= L(i, k) * b[k];
+		b[i] /= L(i, i);
+	}
+	for (int i = N - 1; i >= 0; i--) {
+		for (int k = i + 1; k < N; k++) b[i] -= L(k, i) * b[k];
+		b[i] /= L(i, i);
+	}
+	return b;
+}
+
+// Adds lambda times the diagonal to the diagonal (Marquardt's scaling, so every parameter is damped in its own units)
+template <int N>
+inline void damp(cv::Matx<double, N, N>& A, double lambda) {
+	for (int i = 0; i < N; i++) A(i, i) += lambda * std::max(A(i, i), DBL_EPSILON);
+}
+
+SharedIntrinsics toSharedIntrinsics(const Intrinsics& intrinsics);
+cv::Vec2d projectDistorted(const SharedIntrinsics& p, const cv::Vec3d& Xc, cv::Matx23d* dPoint = nullptr);
+CalibrationResult calibrateSparse(const std::vector<std::vector<cv::Point2f>>& foundPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, const Intrinsics* initialGuess = nullptr, int maxIterations = 30, unsigned workerCount = 0, const std::vector<Extrinsics>* initialPoses = nullptr);
+double refineCalibrationSparse(const std::vector<std::vector<cv::Point2f>>& foundPoints, const std::vector<cv::Point3f>& boardPoints, SharedIntrinsics& intrinsics, std::vector<cv::Matx33d>& rotations, std::vector<cv::Vec3d>& translations, int maxIterations = 30, unsigned workerCount = 0);
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// One image of a frame pair on its way to a detector
+struct StereoImage
+{
+	size_t pair;
+	int side; // 0 left, 1 right
+	cv::Mat gray;
+};
+
+// A frame pair on its way to the rectification stage
+struct StereoFrame
+{
+	cv::Mat left, right;
+};
+
+// Reads the next synchronized pair; both frames are grabbed before either is decoded, so they are as close in
+// time as the two sources allow
+static bool readPair(VideoCapture& left, VideoCapture& right, cv::Mat& leftFrame, cv::Mat& rightFrame) {
+	if (!left.grab() || !right.grab()) return false;
+	return left.retrieve(leftFrame) && right.retrieve(rightFrame) && !leftFrame.empty() && !rightFrame.empty();
+}
+
+// Calibrates a stereo pair from the corners both cameras found in the same board poses
+// Each camera is calibrated on its own first, both at once; stereoCalibrate then keeps those intrinsics fixed and
+// only solves for the pose between the cameras, which converges far more reliably than solving everything together
+StereoCalibrationResult calibrateStereoFromCorners(const std::vector<std::vector<Point2f>>& leftPoints, const std::vector<std::vector<Point2f>>& rightPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, double alpha, unsigned workerCount) {
+	TRACE_SCOPE("calibrateStereoFromCorners");
+	CV_Assert(leftPoints.size() == rightPoints.size());
+	StereoCalibrationResult result;
+	result.imageSize = imageSize;
+	if (leftPoints.size() < 3) {
+		printf("Found the board in both cameras %zu times, at least 3 are needed\n", leftPoints.size());
+		return result;
+	}
+
+	CalibrationResult leftCalibration, rightCalibration;
+	std::thread rightSolver([&]() {
+		rightCalibration = calibrateFromCorners(rightPoints, imageSize, boardSize, squareEdgeLength, nullptr, 30, workerCount);
+	});
+	leftCalibration = calibrateFromCorners(leftPoints, imageSize, boardSize, squareEdgeLength, nullptr, 30, workerCount);
+	rightSolver.join();
+	result.left = leftCalibration.intrinsics;
+	result.right = rightCalibration.intrinsics;
+
+	vector<Point3f> boardPoints;
+	createKnownBoardPosition(boardSize, squareEdgeLength, boardPoints);
+	vector<vector<Point3f>> objectPoints(leftPoints.size(), boardPoints);
+	{
+		TRACE_SCOPE("stereoCalibrate");
+		result.projectionError = stereoCalibrate(objectPoints, leftPoints, rightPoints, result.left.K, result.left.D, result.right.K, result.right.D,
+			imageSize, result.R, result.T, result.E, result.F, CALIB_FIX_INTRINSIC, TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, 100, 1e-6));
+	}
+	{
+		TRACE_SCOPE("stereoRectify");
+		stereoRectify(result.left.K, result.left.D, result.right.K, result.right.D, imageSize, result.R, result.T,
+			result.R1, result.R2, result.P1, result.P2, result.Q, CALIB_ZERO_DISPARITY, alpha, imageSize, &result.validLeft, &result.validRight);
+	}
+	return result;
+}
+
+// Calibrates a stereo pair from two synchronized sources, each anything openVideoSource accepts
+// A reader thread takes every frameStride-th pair and queues its two images separately, so the detector threads
+// search the left and the right frame of a pair at the same time; only pairs with the board in both images are used
+StereoCalibrationResult cameraCalibrationStereo(const std::string& leftSource, const std::string& rightSource, cv::Size boardSize, float squareEdgeLength, const StereoOptions& options) {
+	VideoCapture leftCapture, rightCapture;
+	if (!openVideoSource(leftCapture, leftSource) || !openVideoSource(rightCapture, rightSource)) return StereoCalibrationResult();
+
+	unsigned workerCount = options.workerCount;
+	if (workerCount == 0) { // Leave one hardware thread for the reader
+		unsigned hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	BoundedQueue<StereoImage> queue(options.queueDepth);
+	vector<vector<Point2f>> corners[2];
+	vector<char> found[2];
+	for (int side = 0; side < 2; side++) {
+		corners[side].resize(options.maxPairs);
+		found[side].assign(options.maxPairs, 0);
+	}
+	vector<size_t> pairFrames;
+	Size imageSize;
+
+	// Read stage
+	std::thread reader([&]() {
+		Mat leftFrame, rightFrame;
+		for (int frameIndex = 0; pairFrames.size() < options.maxPairs && readPair(leftCapture, rightCapture, leftFrame, rightFrame); frameIndex++) {
+			if (frameIndex % std::max(1, options.frameStride) != 0) continue;
+			if (leftFrame.size() != rightFrame.size()) {
+				printf("The left and right frames differ in size\n");
+				break;
+			}
+			TRACE_SCOPE("read pair");
+			imageSize = leftFrame.size();
+			size_t pair = pairFrames.size();
+			pairFrames.push_back((size_t) frameIndex);
+			const Mat* frames[2] = { &leftFrame, &rightFrame };
+			bool open = true;
+			for (int side = 0; side < 2 && open; side++) {
+				Mat gray;
+				if (frames[side]->channels() == 1) gray = frames[side]->clone();
+				else cvtColor(*frames[side], gray, COLOR_BGR2GRAY);
+				open = queue.push(StereoImage{ pair, side, gray });
+			}
+			if (!open) break;
+		}
+		queue.close();
+	});
+
+	// Detection stage
+	auto detector = [&]() {
+		StereoImage image;
+		while (queue.pop(image)) {
+			TRACE_SCOPE("detect");
+			found[image.side][image.pair] = detectChessboard(image.gray, 1.0, boardSize, corners[image.side][image.pair], options.detection);
+			image.gray.release();
+		}
+	};
+	std::vector<std::thread> detectors;
+	for (unsigned w = 0; w < workerCount; w++) detectors.emplace_back(detector);
+
+	reader.join();
+	for (std::thread& t : detectors) t.join();
+
+	vector<vector<Point2f>> leftPoints, rightPoints;
+	vector<size_t> pairIndices;
+	for (size_t pair = 0; pair < pairFrames.size(); pair++) {
+		if (!found[0][pair] || !found[1][pair]) continue;
+		leftPoints.push_back(std::move(corners[0][pair]));
+		rightPoints.push_back(std::move(corners[1][pair]));
+		pairIndices.push_back(pairFrames[pair]);
+	}
+	printf("Found the board in both cameras in %zu of %zu frame pairs\n", pairIndices.size(), pairFrames.size());
+
+	StereoCalibrationResult result = calibrateStereoFromCorners(leftPoints, rightPoints, imageSize, boardSize, squareEdgeLength, options.alpha, options.workerCount);
+	result.pairIndices = pairIndices;
+	return result;
+}
+
+// Builds the rectification maps of both cameras, one camera per thread
+StereoRectificationMaps buildStereoRectificationMaps(const StereoCalibrationResult& calibration) {
+	TRACE_SCOPE("buildStereoRectificationMaps");
+	StereoRectificationMaps maps;
+	parallelFor(2, 2, [&](size_t side) {
+		if (side == 0) maps.left = buildRectificationMaps(calibration.left, calibration.R1, calibration.P1, calibration.imageSize);
+		else maps.right = buildRectificationMaps(calibration.right, calibration.R2, calibration.P2, calibration.imageSize);
+	});
+	return maps;
+}
+
+// Rectifies both frames of a pair
+void rectifyStereoPair(const cv::Mat& left, const cv::Mat& right, cv::Mat& rectifiedLeft, cv::Mat& rectifiedRight, const StereoRectificationMaps& maps) {
+	TRACE_SCOPE("rectifyStereoPair");
+	undistortFrame(left, rectifiedLeft, maps.left);
+	undistortFrame(right, rectifiedRight, maps.right);
+}
+
+// Rectifies two synchronized streams into row-aligned frames and writes them to sink as "Rectified left/right"
+// Reading and rectifying run on their own threads with at most queueDepth pairs between them, so decoding the next
+// pair overlaps with remapping the current one; returns the number of pairs written
+size_t rectifyStereoStream(const std::string& leftSource, const std::string& rightSource, const StereoRectificationMaps& maps, FrameSink& sink, size_t queueDepth) {
+	VideoCapture leftCapture, rightCapture;
+	if (maps.empty() || !openVideoSource(leftCapture, leftSource) || !openVideoSource(rightCapture, rightSource)) return 0;
+
+	BoundedQueue<StereoFrame> queue(queueDepth);
+	std::thread reader([&]() {
+		while (true) {
+			TRACE_SCOPE("read pair");
+			StereoFrame frame;
+			if (!readPair(leftCapture, rightCapture, frame.left, frame.right)) break;
+			if (!queue.push(std::move(frame))) break;
+		}
+		queue.close();
+	});
+
+	// Fresh outputs for every pair, since an asynchronous sink may still hold the previous ones
+	size_t pairs = 0;
+	StereoFrame frame;
+	while (queue.pop(frame)) {
+		if (frame.left.size() != maps.left.imageSize || frame.right.size() != maps.right.imageSize) {
+			printf("Frame pair %zu does not match the calibrated resolution\n", pairs);
+			break;
+		}
+		Mat rectifiedLeft, rectifiedRight;
+		rectifyStereoPair(frame.left, frame.right, rectifiedLeft, rectifiedRight, maps);
+		sink.write("Rectified left", rectifiedLeft);
+		sink.write("Rectified right", rectifiedRight);
+		pairs++;
+	}
+	queue.close(); // Unblocks the reader if the loop stopped early
+	reader.join();
+	return pairs;
+}
\ No newline at end of file
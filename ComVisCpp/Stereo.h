@@ -0,0 +1,40 @@
+#pragma once
+
+// Settings of the stereo calibration mode
+struct StereoOptions
+{
+	int frameStride = 10;   // consider every n-th frame pair as a view only
+	size_t maxPairs = 40;   // stop reading after this many candidate pairs
+	double alpha = 0.0;     // stereoRectify: 0 keeps only valid pixels in the rectified frames, 1 every source pixel
+	size_t queueDepth = 4;  // frames waiting for a detector at most
+	unsigned workerCount = 0;
+	DetectionOptions detection;
+};
+
+// Calibration of a stereo pair: both cameras, the pose of the right camera relative to the left one and the
+// rectification that makes their epipolar lines horizontal and row aligned (see stereoRectify)
+struct StereoCalibrationResult
+{
+	Intrinsics left, right;
+	cv::Mat R, T;              // right camera pose in left camera coordinates
+	cv::Mat E, F;              // essential and fundamental matrix
+	cv::Mat R1, R2, P1, P2, Q; // rectifying rotations, projections in the rectified frames and the disparity-to-depth matrix
+	cv::Rect validLeft, validRight;
+	cv::Size imageSize;
+	std::vector<size_t> pairIndices; // frame pair each view comes from
+	double projectionError = 0.0;
+};
+
+// Rectification maps of both cameras of a stereo pair
+struct StereoRectificationMaps
+{
+	UndistortionMaps left, right;
+
+	bool empty() const { return left.empty() || right.empty(); }
+};
+
+StereoCalibrationResult calibrateStereoFromCorners(const std::vector<std::vector<cv::Point2f>>& leftPoints, const std::vector<std::vector<cv::Point2f>>& rightPoints, cv::Size imageSize, cv::Size boardSize, float squareEdgeLength, double alpha = 0.0, unsigned workerCount = 0);
+StereoCalibrationResult cameraCalibrationStereo(const std::string& leftSource, const std::string& rightSource, cv::Size boardSize, float squareEdgeLength, const StereoOptions& options = StereoOptions());
+StereoRectificationMaps buildStereoRectificationMaps(const StereoCalibrationResult& calibration);
+void rectifyStereoPair(const cv::Mat& left, const cv::Mat& right, cv::Mat& rectifiedLeft, cv::Mat& rectifiedRight, const StereoRectificationMaps& maps);
+size_t rectifyStereoStream(const std::string& leftSource, const std::string& rightSource, const StereoRectificationMaps& maps, FrameSink& sink, size_t queueDepth = 4);
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "pch.h"
+
+using namespace std;
+
+// Events of one thread; only the owning thread appends, the buffer itself is owned by the registry below
+// so that it outlives the thread
+struct TraceBuffer
+{
+	int threadId;
+	std::vector<TraceEvent> events;
+};
+
+static std::mutex traceRegistryMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> traceRegistry;
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+std::atomic<bool> tracingEnabled(false);
+
+void setTracingEnabled(bool enabled) {
+	tracingEnabled = enabled;
+}
+
+#if COMVIS_TRACING
+
+int64_t traceNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+// The registry lock is only taken the first time a thread records an event
+static TraceBuffer& threadTraceBuffer() {
+	thread_local TraceBuffer* buffer = nullptr;
+	if (!buffer) {
+		std::lock_guard<std::mutex> lock(traceRegistryMutex);
+		traceRegistry.emplace_back(new TraceBuffer());
+		buffer = traceRegistry.back().get();
+		buffer->threadId = (int) traceRegistry.size();
+		buffer->events.reserve(4096);
+	}
+	return *buffer;
+}
+
+void recordTraceEvent(const char* name, int64_t start, int64_t duration) {
+	TraceEvent event = { name, start, duration };
+	threadTraceBuffer().events.push_back(event);
+}
+
+#endif
+
+// Writes all recorded events as Chrome trace JSON; call it once the traced work has finished
+bool writeChromeTrace(const std::string& path) {
+	FILE* out = fopen(path.c_str(), "w");
+	if (!out) {
+		printf("Could not write trace %s\n", path.c_str());
+		return false;
+	}
+
+	fprintf(out, "{\"traceEvents\":[");
+	bool first = true;
+	std::lock_guard<std::mutex> lock(traceRegistryMutex);
+	for (const std::unique_ptr<TraceBuffer>& buffer : traceRegistry) {
+		for (const TraceEvent& event : buffer->events) {
+			fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",", event.name, buffer->threadId, event.start * 1e-3, event.duration * 1e-3);
+			first = false;
+		}
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	return true;
+}
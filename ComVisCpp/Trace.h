@@ -0,0 +1,56 @@
+#pragma once
+
+// Scoped-timer tracing, exported in the Chrome trace event format (chrome://tracing or ui.perfetto.dev)
+// Build with COMVIS_TRACING=0 to compile every TRACE_SCOPE out; otherwise a scope costs one relaxed atomic load
+// while tracing is disabled at runtime. Each thread appends to its own buffer, so recording takes no lock
+#ifndef COMVIS_TRACING
+#define COMVIS_TRACING 1
+#endif
+
+struct TraceEvent
+{
+	const char* name; // must outlive the trace, string literals in practice
+	int64_t start;    // nanoseconds since the trace clock started
+	int64_t duration;
+};
+
+void setTracingEnabled(bool enabled);
+bool writeChromeTrace(const std::string& path);
+
+#if COMVIS_TRACING
+
+extern std::atomic<bool> tracingEnabled;
+
+int64_t traceNow();
+void recordTraceEvent(const char* name, int64_t start, int64_t duration);
+
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name) : name(tracingEnabled.load(std::memory_order_relaxed) ? name : nullptr)
+	{
+		if (this->name) start = traceNow();
+	}
+
+	~TraceScope()
+	{
+		if (name) recordTraceEvent(name, start, traceNow() - start);
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* name;
+	int64_t start = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) ((void) 0)
+
+#endif
\ No newline at end of file
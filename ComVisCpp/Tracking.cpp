@@ -0,0 +1,92 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+BoardTracker::BoardTracker(cv::Size boardSize, const TrackingOptions& options) : boardSize(boardSize), options(options) {
+	for (int y = 0; y < boardSize.height; y++) {
+		for (int x = 0; x < boardSize.width; x++) gridPoints.push_back(Point2f((float) x, (float) y));
+	}
+}
+
+// Forgets the board, so that the next update detects it from scratch
+void BoardTracker::reset() {
+	tracking = false;
+	previousPyramid.clear();
+	previousCorners.clear();
+}
+
+// Locates the board in the next frame of the stream
+// While the board is tracked this costs one pyramid and one optical flow pass; once it is lost the frame is searched
+// with detectChessboard, unless allowDetection is false (then the update fails and the tracker stays lost)
+// A non-empty searchRegion (see predictBoardRegion) is searched before the whole frame
+bool BoardTracker::update(const cv::Mat& frame, std::vector<Point2f>& corners, bool allowDetection, cv::Rect searchRegion) {
+	Mat gray;
+	if (frame.channels() == 1) gray = frame;
+	else cvtColor(frame, gray, COLOR_BGR2GRAY);
+
+	if (tracking && trackCorners(gray, corners)) {
+		framesTracked++;
+	}
+	else {
+		reset();
+		if (!allowDetection) return false;
+		TRACE_SCOPE("redetect");
+		if (searchRegion.area() > 0 && detectChessboardInRegion(gray, searchRegion, boardSize, corners, options.detection)) framesInRegion++;
+		else if (!detectChessboard(gray, 1.0, boardSize, corners, options.detection)) return false;
+		framesDetected++;
+		Size window(options.windowSize, options.windowSize);
+		buildOpticalFlowPyramid(gray, pyramid, window, options.pyramidLevels);
+	}
+
+	tracking = true;
+	previousCorners = corners;
+	lastSeen = corners;
+	std::swap(previousPyramid, pyramid);
+	return true;
+}
+
+// Follows the previous corners into gray; fills pyramid with the flow pyramid of gray for the next update
+bool BoardTracker::trackCorners(const cv::Mat& gray, std::vector<Point2f>& corners) {
+	TRACE_SCOPE("track");
+	Size window(options.windowSize, options.windowSize);
+	buildOpticalFlowPyramid(gray, pyramid, window, options.pyramidLevels);
+	calcOpticalFlowPyrLK(previousPyramid, pyramid, previousCorners, corners, status, flowError, window, options.pyramidLevels);
+
+	Rect bounds(0, 0, gray.cols, gray.rows);
+	for (size_t i = 0; i < corners.size(); i++) {
+		if (!status[i] || !bounds.contains(corners[i])) return false;
+	}
+
+	if (options.refine) {
+		// Same window rule as detectChessboard, but the flow is already close so a small window is enough
+		RefinementOptions refinement;
+		refinement.halfWindow = windowForSpacing(corners, 5);
+		refinement.maxIterations = 10;
+		refineCorners(gray, corners, refinement);
+	}
+	return fitsBoard(corners);
+}
+
+// Checks the corners against the board geometry: a plane seen through a pinhole maps the grid by a homography, so
+// corners that slid onto a neighbouring square or onto the background stand out in the residuals
+bool BoardTracker::fitsBoard(const std::vector<Point2f>& corners) const {
+	Mat H = findHomography(gridPoints, corners, 0);
+	if (H.empty()) return false;
+
+	vector<Point2f> fitted;
+	perspectiveTransform(gridPoints, fitted, H);
+
+	double spacing = 0.0;
+	for (int y = 0; y < boardSize.height; y++) {
+		int row = y * boardSize.width;
+		spacing += norm(corners[row + boardSize.width - 1] - corners[row]) / (boardSize.width - 1);
+	}
+	spacing /= boardSize.height;
+
+	double maxError = options.maxGridError * spacing;
+	for (size_t i = 0; i < corners.size(); i++) {
+		if (norm(corners[i] - fitted[i]) > maxError) return false;
+	}
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Settings of the frame-to-frame board tracker
+// Tracked corners are accepted only while they still form a board: every corner has to be followed, and a homography
+// from the board plane has to explain all of them to within maxGridError of the corner spacing
+struct TrackingOptions
+{
+	int windowSize = 21;        // Lucas-Kanade window in pixels
+	int pyramidLevels = 3;      // pyramid levels above full resolution used by the flow
+	double maxGridError = 0.2;  // largest corner offset from the fitted board, relative to the corner spacing
+	bool refine = true;         // polish the tracked corners with refineCorners so that they do not drift
+	DetectionOptions detection; // used whenever the board has to be found from scratch
+};
+
+// Follows a chess board through a video
+// The first frame and every frame after the board was lost go through full detection; all others only propagate the
+// previous corners with pyramidal Lucas-Kanade optical flow
+class BoardTracker
+{
+public:
+	BoardTracker(cv::Size boardSize, const TrackingOptions& options = TrackingOptions());
+
+	bool update(const cv::Mat& frame, std::vector<cv::Point2f>& corners, bool allowDetection = true, cv::Rect searchRegion = cv::Rect());
+	void reset();
+	bool isTracking() const { return tracking; }
+	const std::vector<cv::Point2f>& lastCorners() const { return lastSeen; } // where the board was seen last, also after it was lost
+
+	size_t framesTracked = 0;  // frames the board was followed in
+	size_t framesDetected = 0; // frames that needed full detection
+	size_t framesInRegion = 0; // of those, frames the board was found inside the search region
+
+private:
+	bool trackCorners(const cv::Mat& gray, std::vector<cv::Point2f>& corners);
+	bool fitsBoard(const std::vector<cv::Point2f>& corners) const;
+
+	const cv::Size boardSize;
+	const TrackingOptions options;
+	std::vector<cv::Point2f> gridPoints;
+
+	bool tracking = false;
+	std::vector<cv::Mat> previousPyramid;
+	std::vector<cv::Point2f> previousCorners;
+	std::vector<cv::Point2f> lastSeen;
+	std::vector<cv::Mat> pyramid;
+	std::vector<uchar> status;
+	std::vector<float> flowError;
+};
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+static const char undistortionMagic[4] = { 'C', 'V', 'U', 'M' };
+static const uint32_t undistortionVersion = 1;
+
+// Layout of a map file: this header, then map1 and map2 row by row without padding
+struct UndistortionHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	int32_t width, height;
+	double newK[9];
+};
+
+// Identifies the maps of a camera: K, D, the resolution and how much of the distorted border is kept
+uint64_t undistortionKey(const Intrinsics& intrinsics, cv::Size imageSize, double alpha) {
+	Matx33d K(intrinsics.K);
+	Mat D;
+	intrinsics.D.convertTo(D, CV_64F);
+	int size[2] = { imageSize.width, imageSize.height };
+	uint64_t hash = fnv1a(fnvOffsetBasis, K.val, sizeof(K.val));
+	hash = fnv1a(hash, D.ptr<double>(), D.total() * sizeof(double));
+	hash = fnv1a(hash, size, sizeof(size));
+	return fnv1a(hash, &alpha, sizeof(alpha));
+}
+
+// Builds the fixed-point maps with initUndistortRectifyMap
+// alpha 0 crops the frame to valid pixels only, 1 keeps every source pixel (see getOptimalNewCameraMatrix)
+UndistortionMaps buildUndistortionMaps(const Intrinsics& intrinsics, cv::Size imageSize, double alpha) {
+	TRACE_SCOPE("buildUndistortionMaps");
+	UndistortionMaps maps;
+	maps.imageSize = imageSize;
+	maps.newK = Matx33d(getOptimalNewCameraMatrix(intrinsics.K, intrinsics.D, imageSize, alpha, imageSize));
+	initUndistortRectifyMap(intrinsics.K, intrinsics.D, Mat(), Mat(maps.newK), imageSize, CV_16SC2, maps.map1, maps.map2);
+	return maps;
+}
+
+// Builds the fixed-point maps that undistort and rotate frames into a rectified view
+// R and P are one camera's rectifying rotation and 3x4 projection from stereoRectify
+UndistortionMaps buildRectificationMaps(const Intrinsics& intrinsics, const cv::Mat& R, const cv::Mat& P, cv::Size imageSize) {
+	TRACE_SCOPE("buildRectificationMaps");
+	UndistortionMaps maps;
+	maps.imageSize = imageSize;
+	maps.newK = Matx33d(P.colRange(0, 3));
+	initUndistortRectifyMap(intrinsics.K, intrinsics.D, R, P, imageSize, CV_16SC2, maps.map1, maps.map2);
+	return maps;
+}
+
+// Reads maps written by saveUndistortionMaps; returns false when the file is missing, damaged or for another key
+bool loadUndistortionMaps(const std::string& path, uint64_t key, UndistortionMaps& maps) {
+	TRACE_SCOPE("loadUndistortionMaps");
+	std::ifstream file(path, std::ios::binary);
+	UndistortionHeader header;
+	if (!file.read((char*) &header, sizeof(header))) return false;
+	if (memcmp(header.magic, undistortionMagic, 4) != 0 || header.version != undistortionVersion || header.key != key) return false;
+	if (header.width <= 0 || header.height <= 0) return false;
+
+	UndistortionMaps loaded;
+	loaded.imageSize = Size(header.width, header.height);
+	loaded.newK = Matx33d(header.newK);
+	loaded.map1.create(loaded.imageSize, CV_16SC2);
+	loaded.map2.create(loaded.imageSize, CV_16UC1);
+	file.read((char*) loaded.map1.data, loaded.map1.total() * loaded.map1.elemSize());
+	file.read((char*) loaded.map2.data, loaded.map2.total() * loaded.map2.elemSize());
+	if (!file) return false;
+	maps = loaded;
+	return true;
+}
+
+// Writes the maps next to a temporary name first, so an interrupted run never leaves a truncated file behind
+bool saveUndistortionMaps(const std::string& path, uint64_t key, const UndistortionMaps& maps) {
+	CV_Assert(maps.map1.isContinuous() && maps.map2.isContinuous());
+	UndistortionHeader header;
+	memcpy(header.magic, undistortionMagic, 4);
+	header.version = undistortionVersion;
+	header.key = key;
+	header.width = maps.imageSize.width;
+	header.height = maps.imageSize.height;
+	memcpy(header.newK, maps.newK.val, sizeof(header.newK));
+
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write((const char*) &header, sizeof(header));
+		file.write((const char*) maps.map1.data, maps.map1.total() * maps.map1.elemSize());
+		file.write((const char*) maps.map2.data, maps.map2.total() * maps.map2.elemSize());
+		if (!file) {
+			printf("Could not write undistortion maps %s\n", temporaryPath.c_str());
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		printf("Could not replace undistortion maps %s\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Loads the maps of this camera from cacheDirectory, or builds and stores them there when there are none yet
+UndistortionMaps getUndistortionMaps(const Intrinsics& intrinsics, cv::Size imageSize, const std::string& cacheDirectory, double alpha) {
+	uint64_t key = undistortionKey(intrinsics, imageSize, alpha);
+	char name[40];
+	sprintf(name, "undistort_%016llx.bin", (unsigned long long) key);
+	std::string path = name;
+	if (!cacheDirectory.empty()) {
+		char last = cacheDirectory.back();
+		path = cacheDirectory + (last == '/' || last == '\\' ? "" : "/") + name;
+	}
+
+	UndistortionMaps maps;
+	if (loadUndistortionMaps(path, key, maps)) return maps;
+	maps = buildUndistortionMaps(intrinsics, imageSize, alpha);
+	saveUndistortionMaps(path, key, maps);
+	return maps;
+}
+
+// Undistorts one frame with a single remap; cv::remap parallelises its rows itself
+void undistortFrame(const cv::Mat& frame, cv::Mat& undistorted, const UndistortionMaps& maps) {
+	TRACE_SCOPE("undistortFrame");
+	CV_Assert(frame.size() == maps.imageSize);
+	remap(frame, undistorted, maps.map1, maps.map2, INTER_LINEAR, BORDER_CONSTANT);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Lookup tables that undistort frames of one camera at one resolution
+// map1 holds the integer source position of every output pixel (CV_16SC2), map2 the index of its bilinear weights in
+// OpenCV's fixed-point interpolation table (CV_16UC1); together they are a third of the size of float maps and remap
+// reads them without any per-pixel floating point
+struct UndistortionMaps
+{
+	cv::Size imageSize;
+	cv::Matx33d newK;   // camera matrix of the undistorted frames
+	cv::Mat map1, map2;
+
+	bool empty() const { return map1.empty(); }
+};
+
+uint64_t undistortionKey(const Intrinsics& intrinsics, cv::Size imageSize, double alpha);
+UndistortionMaps buildUndistortionMaps(const Intrinsics& intrinsics, cv::Size imageSize, double alpha = 0.0);
+UndistortionMaps buildRectificationMaps(const Intrinsics& intrinsics, const cv::Mat& R, const cv::Mat& P, cv::Size imageSize);
+bool loadUndistortionMaps(const std::string& path, uint64_t key, UndistortionMaps& maps);
+bool saveUndistortionMaps(const std::string& path, uint64_t key, const UndistortionMaps& maps);
+UndistortionMaps getUndistortionMaps(const Intrinsics& intrinsics, cv::Size imageSize, const std::string& cacheDirectory, double alpha = 0.0);
+void undistortFrame(const cv::Mat& frame, cv::Mat& undistorted, const UndistortionMaps& maps);
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "pch.h"
+
+using namespace std;
+using namespace cv;
+
+// Describes where and how the board appears in the image, without needing the intrinsics:
+// its center and size relative to the frame, the in-plane direction of its first row,
+// and the length ratios of opposite edges, which capture the tilt out of the image plane
+cv::Vec<double, 6> boardPoseDescriptor(const std::vector<cv::Point2f>& corners, cv::Size boardSize, cv::Size imageSize) {
+	const Point2f& topLeft = corners[0];
+	const Point2f& topRight = corners[boardSize.width - 1];
+	const Point2f& bottomLeft = corners[corners.size() - boardSize.width];
+	const Point2f& bottomRight = corners.back();
+
+	double diagonal = sqrt((double) imageSize.width * imageSize.width + (double) imageSize.height * imageSize.height);
+	Point2f center = (topLeft + topRight + bottomLeft + bottomRight) * 0.25f;
+	double top = norm(topRight - topLeft), bottom = norm(bottomRight - bottomLeft);
+	double left = norm(bottomLeft - topLeft), right = norm(bottomRight - topRight);
+	double angle = atan2(topRight.y - topLeft.y, topRight.x - topLeft.x);
+
+	return cv::Vec<double, 6>(
+		center.x / imageSize.width,
+		center.y / imageSize.height,
+		sqrt(0.5 * (top + bottom) * 0.5 * (left + right)) / diagonal * 4.0,
+		sin(angle) * 0.5,
+		log(top / bottom),
+		log(left / right)
+	);
+}
+
+// The tracker searches with the same detection settings as the untracked path
+static TrackingOptions trackingOptions(const VideoCalibrationOptions& options) {
+	TrackingOptions tracking = options.tracking;
+	tracking.detection = options.detection;
+	return tracking;
+}
+
+VideoCalibrator::VideoCalibrator(cv::Size boardSize, float squareEdgeLength, const VideoCalibrationOptions& options) : boardSize(boardSize), squareEdgeLength(squareEdgeLength), options(options), tracker(boardSize, trackingOptions(options)), poseEstimator(boardSize, squareEdgeLength) {
+}
+
+VideoCalibrator::~VideoCalibrator() {
+	waitForUpdate();
+}
+
+// Feeds the next frame of the stream; returns true when it was accepted as a new calibration view
+bool VideoCalibrator::addFrame(const cv::Mat& frame) {
+	bool candidate = frameIndex++ % std::max(1, options.frameStride) == 0;
+	if (views.size() >= options.maxViews) return false;
+	if (!candidate && !options.track) return false;
+
+	TRACE_SCOPE("video frame");
+	imageSize = frame.size();
+	std::vector<Point2f> corners;
+	if (options.track) {
+		// Following the board is cheap enough for every frame, which keeps it tracked between two candidates;
+		// only candidates may fall back to full detection once it is lost
+		bool tracked = tracker.update(frame, corners, candidate, candidate ? predictSearchRegion() : Rect());
+		if (tracked) trackPose(corners);
+		else poseEstimator.reset();
+		if (!tracked || !candidate) return false;
+	}
+	else if (!detectChessboard(frame, 1.0, boardSize, corners, options.detection)) return false;
+
+	// Only keep the view if it adds pose diversity
+	cv::Vec<double, 6> descriptor = boardPoseDescriptor(corners, boardSize, imageSize);
+	for (const cv::Vec<double, 6>& accepted : descriptors) {
+		if (norm(descriptor - accepted) < options.minPoseDistance) return false;
+	}
+	views.push_back(std::move(corners));
+	viewFrames.push_back((size_t) frameIndex - 1);
+	descriptors.push_back(descriptor);
+
+	if (views.size() >= options.minViews && views.size() - viewsAtLastUpdate >= options.updateEvery) startUpdate();
+	return true;
+}
+
+// Copies the intrinsics of the most recent calibration; returns false while there is none yet
+bool VideoCalibrator::currentIntrinsics(Intrinsics& intrinsics) const {
+	std::lock_guard<std::mutex> lock(resultMutex);
+	intrinsics = result.intrinsics;
+	return calibrated;
+}
+
+// Once there is a calibration, follows the board pose through every tracked frame
+// Each solve starts from the pose of the frame before, which costs microseconds against a full calibration
+void VideoCalibrator::trackPose(const std::vector<Point2f>& corners) {
+	Intrinsics intrinsics;
+	if (!currentIntrinsics(intrinsics)) return;
+	poseValid = poseEstimator.estimate(intrinsics, corners, pose);
+}
+
+// Copies the board pose of the last frame the board was seen in; returns false before there is one
+bool VideoCalibrator::boardPose(Extrinsics& lastPose) const {
+	lastPose = pose;
+	return poseValid;
+}
+
+// Once there is a calibration, a lost board is searched first around the pose it was last seen in
+// Returns an empty rectangle when there is nothing to predict from, which makes the tracker search the whole frame
+cv::Rect VideoCalibrator::predictSearchRegion() {
+	if (tracker.isTracking() || tracker.lastCorners().empty()) return Rect();
+
+	Intrinsics intrinsics;
+	if (!currentIntrinsics(intrinsics)) return Rect();
+
+	// The calibration may have arrived after the board was lost, then its last corners have no pose yet
+	if (!poseValid) poseValid = poseEstimator.estimate(intrinsics, tracker.lastCorners(), pose);
+	if (!poseValid) return Rect();
+	return predictBoardRegion(intrinsics, pose, boardSize, squareEdgeLength, imageSize, options.searchMargin);
+}
+
+// Starts an update on the solver thread with a snapshot of the accepted views
+// If the previous update is still running nothing happens; the views are picked up by a later update instead
+// Always uses the sparse solver, the one that can continue from the previous poses: only the views added since the
+// last update need solvePnP, and a few iterations move K, D and the known poses to the new optimum
+void VideoCalibrator::startUpdate() {
+	if (solverBusy) return;
+	waitForUpdate();
+
+	solverBusy = true;
+	viewsAtLastUpdate = views.size();
+
+	Intrinsics guess;
+	std::vector<Extrinsics> poses;
+	bool warmStart;
+	{
+		std::lock_guard<std::mutex> lock(resultMutex);
+		warmStart = calibrated;
+		guess.K = result.intrinsics.K.clone();
+		guess.D = result.intrinsics.D.clone();
+		poses = result.extrinsics; // Views are only ever appended, so these are the poses of the first views
+	}
+
+	std::vector<std::vector<Point2f>> snapshot = views;
+	std::vector<size_t> frames = viewFrames;
+	Size size = imageSize;
+	solver = std::thread([this, snapshot, frames, guess, poses, warmStart, size]() {
+		TRACE_SCOPE("incremental update");
+		CalibrationResult update = calibrateSparse(snapshot, size, boardSize, squareEdgeLength, warmStart ? &guess : nullptr, options.updateIterations, 0, warmStart ? &poses : nullptr);
+		update.viewIndices = frames;
+		{
+			std::lock_guard<std::mutex> lock(resultMutex);
+			result = update;
+			calibrated = true;
+		}
+		solverBusy = false;
+	});
+}
+
+void VideoCalibrator::waitForUpdate() {
+	if (solver.joinable()) solver.join();
+}
+
+// Copies the most recent calibration; returns false while there is none yet
+bool VideoCalibrator::latest(CalibrationResult& calibration) const {
+	std::lock_guard<std::mutex> lock(resultMutex);
+	calibration = result;
+	return calibrated;
+}
+
+// Waits for the running update and folds in the views accepted since, then returns the final calibration
+// The view indices of the result are frame numbers in the stream
+CalibrationResult VideoCalibrator::finish() {
+	waitForUpdate();
+	if (!views.empty() && (!calibrated || views.size() > viewsAtLastUpdate)) {
+		startUpdate();
+		waitForUpdate();
+	}
+	return result;
+}
+
+// Opens a video file, an image sequence pattern (e.g. data/chessboard%d.jpg) or a camera index
+bool openVideoSource(cv::VideoCapture& capture, const std::string& source) {
+	bool isDevice = !source.empty() && std::all_of(source.begin(), source.end(), ::isdigit);
+	if (isDevice) capture.open(atoi(source.c_str()));
+	else capture.open(source);
+	if (!capture.isOpened()) {
+		printf("Could not open video source %s\n", source.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Calibrates from any source openVideoSource accepts
+CalibrationResult cameraCalibrationVideo(const std::string& source, cv::Size boardSize, float squareEdgeLength, const VideoCalibrationOptions& options) {
+	VideoCapture capture;
+	if (!openVideoSource(capture, source)) return CalibrationResult();
+
+	VideoCalibrator calibrator(boardSize, squareEdgeLength, options);
+	Mat frame;
+	while (calibrator.viewCount() < options.maxViews && capture.read(frame)) {
+		if (calibrator.addFrame(frame)) printf("Accepted view %zu\n", calibrator.viewCount());
+	}
+	if (options.track) printf("Board tracked in %zu frames, detected in %zu (%zu inside the predicted region)\n", calibrator.boardTracker().framesTracked, calibrator.boardTracker().framesDetected, calibrator.boardTracker().framesInRegion);
+	return calibrator.finish();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Settings of the live video calibration mode
+struct VideoCalibrationOptions
+{
+	int frameStride = 5;           // consider every n-th frame as a view only
+	size_t minViews = 8;           // accepted views needed before the first calibration
+	size_t updateEvery = 4;        // accepted views between two incremental updates
+	size_t maxViews = 60;          // stop accepting views after this many
+	double minPoseDistance = 0.12; // how different a view has to be from every accepted view (see boardPoseDescriptor)
+	int updateIterations = 10;     // solver iterations per incremental update
+	bool track = true;             // follow the board with optical flow on every frame instead of re-detecting it
+	TrackingOptions tracking;      // used when track is set
+	double searchMargin = 0.25;    // padding of the predicted board region a lost board is searched in first, relative to its size
+	DetectionOptions detection;
+};
+
+// Calibrates a camera from a stream of frames
+// A frame becomes a calibration view only when the board pose differs enough from the views accepted so far;
+// K and D are then refined on a background thread, warm-started from the previous estimate and poses, so feeding frames
+// never waits for the solver
+class VideoCalibrator
+{
+public:
+	VideoCalibrator(cv::Size boardSize, float squareEdgeLength, const VideoCalibrationOptions& options = VideoCalibrationOptions());
+	~VideoCalibrator();
+
+	bool addFrame(const cv::Mat& frame);
+	bool latest(CalibrationResult& result) const;
+	CalibrationResult finish();
+	size_t viewCount() const { return views.size(); }
+	const BoardTracker& boardTracker() const { return tracker; }
+	bool boardPose(Extrinsics& pose) const;
+
+private:
+	void startUpdate();
+	bool currentIntrinsics(Intrinsics& intrinsics) const;
+	void trackPose(const std::vector<cv::Point2f>& corners);
+	cv::Rect predictSearchRegion();
+	void waitForUpdate();
+
+	const cv::Size boardSize;
+	const float squareEdgeLength;
+	const VideoCalibrationOptions options;
+	cv::Size imageSize;
+	BoardTracker tracker;
+	BoardPoseEstimator poseEstimator;
+	Extrinsics pose;        // of the last frame the board was seen in
+	bool poseValid = false;
+
+	int frameIndex = 0;
+	size_t viewsAtLastUpdate = 0;
+	std::vector<std::vector<cv::Point2f>> views;
+	std::vector<size_t> viewFrames;
+	std::vector<cv::Vec<double, 6>> descriptors;
+
+	std::thread solver;
+	std::atomic<bool> solverBusy{ false };
+	mutable std::mutex resultMutex;
+	CalibrationResult result;
+	bool calibrated = false;
+};
+
+cv::Vec<double, 6> boardPoseDescriptor(const std::vector<cv::Point2f>& corners, cv::Size boardSize, cv::Size imageSize);
+bool openVideoSource(cv::VideoCapture& capture, const std::string& source);
+CalibrationResult cameraCalibrationVideo(const std::string& source, cv::Size boardSize, float squareEdgeLength, const VideoCalibrationOptions& options = VideoCalibrationOptions());
\ No newline at end of file